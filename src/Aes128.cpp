@@ -0,0 +1,396 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "Aes128.h"
+#include "Gd.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define ENOCEAN_AES_NI
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define ENOCEAN_AES_ARMV8
+#endif
+
+namespace EnOcean {
+
+namespace {
+
+//{{{ Software implementation
+//Bytes are bit-sliced: Plane i holds bit i of up to 64 bytes (4 blocks), one byte per bit position. This way the S-box
+//is computed for all bytes at once with AND and XOR only.
+typedef std::array<uint64_t, 8> Planes;
+
+void gfReduce(std::array<uint64_t, 15> &product, Planes &result) {
+  //x^8 = x^4 + x^3 + x + 1
+  for (uint32_t k = 14; k >= 8; k--) {
+    product[k - 4] ^= product[k];
+    product[k - 5] ^= product[k];
+    product[k - 7] ^= product[k];
+    product[k - 8] ^= product[k];
+  }
+  std::copy(product.begin(), product.begin() + 8, result.begin());
+}
+
+void gfMultiply(const Planes &a, const Planes &b, Planes &result) {
+  std::array<uint64_t, 15> product{};
+  for (uint32_t i = 0; i < 8; i++) {
+    for (uint32_t j = 0; j < 8; j++) {
+      product[i + j] ^= a[i] & b[j];
+    }
+  }
+  gfReduce(product, result);
+}
+
+void gfSquare(const Planes &a, Planes &result) {
+  //Squaring is linear in GF(2^8): The square of sum(a_i * x^i) is sum(a_i * x^2i).
+  std::array<uint64_t, 15> product{};
+  for (uint32_t i = 0; i < 8; i++) {
+    product[2 * i] = a[i];
+  }
+  gfReduce(product, result);
+}
+
+/**
+ * Applies the S-box to up to 64 bytes: The inverse in GF(2^8) (computed as x^254) followed by the affine transformation.
+ */
+void subBytes(uint8_t *bytes, size_t size) {
+  Planes x{};
+  for (size_t lane = 0; lane < size; lane++) {
+    for (uint32_t bit = 0; bit < 8; bit++) {
+      x[bit] |= (uint64_t)((bytes[lane] >> bit) & 1u) << lane;
+    }
+  }
+
+  Planes x2, x3, x6, x12, x15, x30, x60, x120, x126, x127, x254;
+  gfSquare(x, x2);
+  gfMultiply(x2, x, x3);
+  gfSquare(x3, x6);
+  gfSquare(x6, x12);
+  gfMultiply(x12, x3, x15);
+  gfSquare(x15, x30);
+  gfSquare(x30, x60);
+  gfSquare(x60, x120);
+  gfMultiply(x120, x6, x126);
+  gfMultiply(x126, x, x127);
+  gfSquare(x127, x254);
+
+  Planes s{};
+  for (uint32_t bit = 0; bit < 8; bit++) {
+    s[bit] = x254[bit] ^ x254[(bit + 4) % 8] ^ x254[(bit + 5) % 8] ^ x254[(bit + 6) % 8] ^ x254[(bit + 7) % 8] ^ (((0x63u >> bit) & 1u) ? ~(uint64_t)0 : 0);
+  }
+
+  for (size_t lane = 0; lane < size; lane++) {
+    uint8_t byte = 0;
+    for (uint32_t bit = 0; bit < 8; bit++) {
+      byte |= (uint8_t)(((s[bit] >> lane) & 1u) << bit);
+    }
+    bytes[lane] = byte;
+  }
+}
+
+inline uint8_t xtime(uint8_t x) {
+  return (uint8_t)((x << 1u) ^ (0x1Bu & (0u - (x >> 7u))));
+}
+
+void shiftRowsMixColumns(uint8_t *block, bool mixColumns) {
+  //The state is stored column by column.
+  std::array<uint8_t, 16> shifted{};
+  for (uint32_t row = 0; row < 4; row++) {
+    for (uint32_t column = 0; column < 4; column++) {
+      shifted[row + 4 * column] = block[row + 4 * ((column + row) % 4)];
+    }
+  }
+  if (!mixColumns) {
+    std::copy(shifted.begin(), shifted.end(), block);
+    return;
+  }
+
+  for (uint32_t column = 0; column < 4; column++) {
+    uint8_t *a = shifted.data() + 4 * column;
+    block[4 * column] = xtime(a[0]) ^ xtime(a[1]) ^ a[1] ^ a[2] ^ a[3];
+    block[4 * column + 1] = a[0] ^ xtime(a[1]) ^ xtime(a[2]) ^ a[2] ^ a[3];
+    block[4 * column + 2] = a[0] ^ a[1] ^ xtime(a[2]) ^ xtime(a[3]) ^ a[3];
+    block[4 * column + 3] = xtime(a[0]) ^ a[0] ^ a[1] ^ a[2] ^ xtime(a[3]);
+  }
+}
+
+void encryptSoftware(const uint8_t *roundKeys, uint8_t *out, const uint8_t *in, size_t blockCount) {
+  std::array<uint8_t, 64> state{};
+  for (size_t firstBlock = 0; firstBlock < blockCount; firstBlock += 4) {
+    size_t blocks = blockCount - firstBlock < 4 ? blockCount - firstBlock : 4;
+    size_t size = blocks * 16;
+    for (size_t i = 0; i < size; i++) {
+      state[i] = in[firstBlock * 16 + i] ^ roundKeys[i % 16];
+    }
+    for (uint32_t round = 1; round <= 10; round++) {
+      subBytes(state.data(), size);
+      for (size_t block = 0; block < blocks; block++) {
+        shiftRowsMixColumns(state.data() + block * 16, round != 10);
+      }
+      for (size_t i = 0; i < size; i++) {
+        state[i] ^= roundKeys[round * 16 + i % 16];
+      }
+    }
+    std::copy(state.begin(), state.begin() + size, out + firstBlock * 16);
+  }
+  std::fill(state.begin(), state.end(), 0);
+}
+//}}}
+
+#ifdef ENOCEAN_AES_NI
+bool hasAesNi() {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+
+__attribute__((target("aes,sse2")))
+void encryptAesNi(const uint8_t *roundKeys, uint8_t *out, const uint8_t *in, size_t blockCount) {
+  __m128i keys[11];
+  for (uint32_t i = 0; i < 11; i++) {
+    keys[i] = _mm_loadu_si128((const __m128i *)(roundKeys + i * 16));
+  }
+
+  size_t block = 0;
+  //Four independent blocks keep the AES unit busy while each instruction's latency passes.
+  for (; block + 4 <= blockCount; block += 4) {
+    __m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + block * 16)), keys[0]);
+    __m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + block * 16 + 16)), keys[0]);
+    __m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + block * 16 + 32)), keys[0]);
+    __m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + block * 16 + 48)), keys[0]);
+    for (uint32_t round = 1; round < 10; round++) {
+      b0 = _mm_aesenc_si128(b0, keys[round]);
+      b1 = _mm_aesenc_si128(b1, keys[round]);
+      b2 = _mm_aesenc_si128(b2, keys[round]);
+      b3 = _mm_aesenc_si128(b3, keys[round]);
+    }
+    _mm_storeu_si128((__m128i *)(out + block * 16), _mm_aesenclast_si128(b0, keys[10]));
+    _mm_storeu_si128((__m128i *)(out + block * 16 + 16), _mm_aesenclast_si128(b1, keys[10]));
+    _mm_storeu_si128((__m128i *)(out + block * 16 + 32), _mm_aesenclast_si128(b2, keys[10]));
+    _mm_storeu_si128((__m128i *)(out + block * 16 + 48), _mm_aesenclast_si128(b3, keys[10]));
+  }
+  for (; block < blockCount; block++) {
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + block * 16)), keys[0]);
+    for (uint32_t round = 1; round < 10; round++) {
+      b = _mm_aesenc_si128(b, keys[round]);
+    }
+    _mm_storeu_si128((__m128i *)(out + block * 16), _mm_aesenclast_si128(b, keys[10]));
+  }
+}
+#endif
+
+#ifdef ENOCEAN_AES_ARMV8
+bool hasArmv8Aes() {
+  return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+}
+
+__attribute__((target("arch=armv8-a+crypto")))
+void encryptArmv8(const uint8_t *roundKeys, uint8_t *out, const uint8_t *in, size_t blockCount) {
+  uint8x16_t keys[11];
+  for (uint32_t i = 0; i < 11; i++) {
+    keys[i] = vld1q_u8(roundKeys + i * 16);
+  }
+
+  for (size_t block = 0; block < blockCount; block++) {
+    //AESE does AddRoundKey, SubBytes and ShiftRows, AESMC MixColumns.
+    uint8x16_t b = vld1q_u8(in + block * 16);
+    for (uint32_t round = 0; round < 9; round++) {
+      b = vaesmcq_u8(vaeseq_u8(b, keys[round]));
+    }
+    b = veorq_u8(vaeseq_u8(b, keys[9]), keys[10]);
+    vst1q_u8(out + block * 16, b);
+  }
+}
+#endif
+
+bool encryptGcrypt(const uint8_t *key, uint8_t *out, const uint8_t *in, size_t size) {
+  gcry_cipher_hd_t handle = nullptr;
+  if (gcry_cipher_open(&handle, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_ECB, GCRY_CIPHER_SECURE) != GPG_ERR_NO_ERROR || !handle) return false;
+  bool result = gcry_cipher_setkey(handle, key, 16) == GPG_ERR_NO_ERROR && gcry_cipher_encrypt(handle, out, size, in, size) == GPG_ERR_NO_ERROR;
+  gcry_cipher_close(handle);
+  return result;
+}
+
+}
+
+Aes128::Aes128(const uint8_t *key, Implementation implementation) : _implementation(implementation) {
+  try {
+    if (implementation == Implementation::none) return;
+    _roundKeys = (uint8_t *)gcry_malloc_secure(176);
+    if (!_roundKeys) {
+      Gd::out.printError("Error: Could not allocate secure memory for AES round keys.");
+      return;
+    }
+    expandKey(key, _roundKeys);
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+Aes128::~Aes128() {
+  //gcry_free() of secure memory wipes it.
+  if (_roundKeys) gcry_free(_roundKeys);
+  _roundKeys = nullptr;
+}
+
+void Aes128::expandKey(const uint8_t *key, uint8_t *roundKeys) {
+  static const uint8_t roundConstants[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+  std::copy(key, key + 16, roundKeys);
+  for (uint32_t i = 4; i < 44; i++) {
+    std::array<uint8_t, 4> word{roundKeys[(i - 1) * 4], roundKeys[(i - 1) * 4 + 1], roundKeys[(i - 1) * 4 + 2], roundKeys[(i - 1) * 4 + 3]};
+    if (i % 4 == 0) {
+      std::rotate(word.begin(), word.begin() + 1, word.end());
+      //Uses the constant time S-box, too.
+      subBytes(word.data(), word.size());
+      word[0] ^= roundConstants[i / 4 - 1];
+    }
+    for (uint32_t j = 0; j < 4; j++) {
+      roundKeys[i * 4 + j] = roundKeys[(i - 4) * 4 + j] ^ word[j];
+    }
+    std::fill(word.begin(), word.end(), 0);
+  }
+}
+
+void Aes128::encrypt(uint8_t *out, const uint8_t *in, size_t blockCount) const {
+  if (!_roundKeys) return;
+  switch (_implementation) {
+#ifdef ENOCEAN_AES_NI
+    case Implementation::aesNi: {
+      encryptAesNi(_roundKeys, out, in, blockCount);
+      break;
+    }
+#endif
+#ifdef ENOCEAN_AES_ARMV8
+    case Implementation::armv8: {
+      encryptArmv8(_roundKeys, out, in, blockCount);
+      break;
+    }
+#endif
+    case Implementation::software: {
+      encryptSoftware(_roundKeys, out, in, blockCount);
+      break;
+    }
+    default: break;
+  }
+}
+
+std::vector<Aes128::Implementation> Aes128::getSupportedImplementations() {
+  std::vector<Implementation> implementations;
+#ifdef ENOCEAN_AES_NI
+  if (hasAesNi()) implementations.push_back(Implementation::aesNi);
+#endif
+#ifdef ENOCEAN_AES_ARMV8
+  if (hasArmv8Aes()) implementations.push_back(Implementation::armv8);
+#endif
+  implementations.push_back(Implementation::software);
+  return implementations;
+}
+
+const std::vector<Aes128::Implementation> &Aes128::getVerifiedImplementations() {
+  static const std::vector<Implementation> verifiedImplementations = []() {
+    std::vector<Implementation> implementations;
+    for (auto implementation : getSupportedImplementations()) {
+      if (selfTest(implementation)) implementations.push_back(implementation);
+      else Gd::out.printError("Error: Native AES implementation \"" + getName(implementation) + "\" failed the known-answer tests. It won't be used.");
+    }
+    return implementations;
+  }();
+  return verifiedImplementations;
+}
+
+Aes128::Implementation Aes128::select(bool allowSoftware) {
+  auto &implementations = getVerifiedImplementations();
+  for (auto implementation : implementations) {
+    if (implementation != Implementation::software || allowSoftware) return implementation;
+  }
+  return Implementation::none;
+}
+
+std::string Aes128::getName(Implementation implementation) {
+  switch (implementation) {
+    case Implementation::aesNi: return "AES-NI";
+    case Implementation::armv8: return "ARMv8";
+    case Implementation::software: return "software";
+    default: return "libgcrypt";
+  }
+}
+
+bool Aes128::selfTest(Implementation implementation) {
+  try {
+    if (implementation == Implementation::none) return false;
+
+    struct Vector {
+      std::array<uint8_t, 16> key;
+      std::array<uint8_t, 16> plain;
+      std::array<uint8_t, 16> cipher;
+    };
+    static const std::array<Vector, 5> vectors{
+        //FIPS-197, appendix C.1
+        Vector{{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F},
+               {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF},
+               {0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A}},
+        //SP 800-38A, F.1.1 (ECB-AES128)
+        Vector{{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C},
+               {0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A},
+               {0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60, 0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97}},
+        Vector{{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C},
+               {0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51},
+               {0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D, 0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF}},
+        Vector{{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C},
+               {0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF},
+               {0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23, 0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88}},
+        Vector{{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C},
+               {0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10},
+               {0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4}}
+    };
+
+    for (auto &vector : vectors) {
+      Aes128 aes(vector.key.data(), implementation);
+      if (!aes.isValid()) return false;
+      std::array<uint8_t, 16> cipher{};
+      aes.encrypt(cipher.data(), vector.plain.data(), 1);
+      if (cipher != vector.cipher) return false;
+    }
+
+    //Random keys and up to 9 blocks, so the multi-block code paths and the remainder handling are covered, too.
+    std::mt19937 generator(0x45534F45);
+    std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+    for (uint32_t i = 0; i < 32; i++) {
+      std::array<uint8_t, 16> key{};
+      for (auto &byte : key) {
+        byte = (uint8_t)byteDistribution(generator);
+      }
+      size_t blockCount = 1 + i % 9;
+      std::vector<uint8_t> plain(blockCount * 16);
+      for (auto &byte : plain) {
+        byte = (uint8_t)byteDistribution(generator);
+      }
+      std::vector<uint8_t> expected(plain.size());
+      if (!encryptGcrypt(key.data(), expected.data(), plain.data(), plain.size())) return false;
+
+      Aes128 aes(key.data(), implementation);
+      if (!aes.isValid()) return false;
+      //In place, as SecurityContext uses it.
+      aes.encrypt(plain.data(), plain.data(), blockCount);
+      if (plain != expected) return false;
+    }
+
+    return true;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,85 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef AES128_H_
+#define AES128_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Built-in AES-128 encryption of single 16 byte blocks (ECB) as needed for EnOcean security.
+ *
+ * Secure telegrams only need one to a few block encryptions, so the per call overhead of libgcrypt's generic cipher
+ * API dominates. This class encrypts blocks directly with the AES instructions of the CPU (AES-NI on x86, the
+ * cryptography extensions on ARMv8). The implementation is selected at runtime. The software implementation computes
+ * the S-box arithmetically on bit-sliced data instead of using lookup tables, so it is constant time, but slower than
+ * libgcrypt's table based code.
+ *
+ * Every implementation has to pass known-answer tests (FIPS-197, SP 800-38A) and match libgcrypt on random keys and
+ * blocks once before it is used (see select()).
+ */
+class Aes128 {
+ public:
+  enum class Implementation : int32_t {
+    none = 0, //Use libgcrypt
+    aesNi = 1,
+    armv8 = 2,
+    software = 3
+  };
+
+  /**
+   * @return The implementations this CPU supports, fastest first. Always contains Implementation::software.
+   */
+  static std::vector<Implementation> getSupportedImplementations();
+
+  /**
+   * @return The supported implementations which passed the known-answer tests, fastest first. The tests run on first
+   * call only.
+   */
+  static const std::vector<Implementation> &getVerifiedImplementations();
+
+  /**
+   * @param allowSoftware Also return the software implementation when the CPU has no AES instructions.
+   * @return The fastest verified implementation or Implementation::none.
+   */
+  static Implementation select(bool allowSoftware);
+
+  static std::string getName(Implementation implementation);
+
+  /**
+   * Compares the implementation with known-answer vectors and with libgcrypt.
+   */
+  static bool selfTest(Implementation implementation);
+
+  /**
+   * Expands the key. The round keys are stored in secure memory.
+   *
+   * @param key 16 bytes.
+   */
+  Aes128(const uint8_t *key, Implementation implementation);
+  ~Aes128();
+  Aes128(const Aes128 &) = delete;
+  Aes128 &operator=(const Aes128 &) = delete;
+
+  bool isValid() const { return _roundKeys != nullptr; }
+  Implementation getImplementation() const { return _implementation; }
+
+  /**
+   * Encrypts "blockCount" 16 byte blocks. "in" and "out" may be the same. Thread safe.
+   */
+  void encrypt(uint8_t *out, const uint8_t *in, size_t blockCount) const;
+ private:
+  Implementation _implementation = Implementation::none;
+  //11 round keys of 16 bytes in the byte order of FIPS-197.
+  uint8_t *_roundKeys = nullptr;
+
+  static void expandKey(const uint8_t *key, uint8_t *roundKeys);
+};
+
+}
+
+#endif
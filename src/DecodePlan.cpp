@@ -0,0 +1,170 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "DecodePlan.h"
+#include "Gd.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace EnOcean {
+
+using namespace BaseLib::DeviceDescription;
+
+bool DecodePlan::Target::isValidChannel(int32_t channel) const {
+  return std::binary_search(validChannels.begin(), validChannels.end(), channel);
+}
+
+std::shared_ptr<const DecodePlan> DecodePlan::get(const PHomegearDevice &device) {
+  static std::mutex plansMutex;
+  static std::unordered_map<const HomegearDevice *, std::pair<std::weak_ptr<HomegearDevice>, std::shared_ptr<const DecodePlan>>> plans;
+
+  if (!device) return std::shared_ptr<const DecodePlan>();
+  try {
+    std::lock_guard<std::mutex> plansGuard(plansMutex);
+    auto planIterator = plans.find(device.get());
+    //The description might have been reloaded to the same address, so the weak pointer is compared, too.
+    if (planIterator != plans.end() && planIterator->second.first.lock() == device) return planIterator->second.second;
+
+    for (auto i = plans.begin(); i != plans.end();) {
+      if (i->second.first.expired()) i = plans.erase(i);
+      else ++i;
+    }
+
+    auto plan = std::make_shared<const DecodePlan>(device);
+    plans[device.get()] = std::make_pair(std::weak_ptr<HomegearDevice>(device), plan);
+    return plan;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return std::make_shared<const DecodePlan>(device);
+}
+
+DecodePlan::DecodePlan(const PHomegearDevice &device) : _device(device) {
+  try {
+    if (!device) return;
+    for (auto &packetIterator : device->packetsByMessageType) {
+      auto &packet = packetIterator.second;
+      if (!packet) continue;
+
+      Frame frame;
+      frame.id = packet->id;
+      frame.channelIndex = packet->channelIndex;
+      if (packet->channelSize < 8.0) frame.channelMask = 0xFFu >> (unsigned)(8u - std::lround(packet->channelSize));
+      frame.channelIndexOffset = packet->channelIndexOffset;
+      frame.fixedChannel = packet->channel;
+
+      for (auto &binaryPayload : packet->binaryPayloads) {
+        Field field;
+        if (binaryPayload->bitSize > 0 && binaryPayload->bitIndex > 0) {
+          field.inPacket = true;
+          field.bitIndex = (uint32_t)binaryPayload->bitIndex;
+          field.bitSize = (uint32_t)binaryPayload->bitSize;
+          field.constValue = binaryPayload->constValueInteger;
+          field.discriminatorOnly = field.constValue > -1 && binaryPayload->parameterId.empty();
+          if (field.constValue > -1 && field.bitSize <= 32) frame.discriminators.push_back(Discriminator{field.bitIndex, field.bitSize, (uint32_t)field.constValue});
+        } else if (binaryPayload->constValueInteger > -1) {
+          BaseLib::HelperFunctions::memcpyBigEndian(field.constData, binaryPayload->constValueInteger);
+        } else continue; //Payloads without position and value are never decoded.
+
+        if (!field.discriminatorOnly) {
+          for (auto &parameter : packet->associatedVariables) {
+            if (!parameter || parameter->physical->groupId != binaryPayload->parameterId) continue;
+            auto parent = parameter->parent();
+            if (!parent) continue;
+
+            Target target;
+            target.parameterId = parameter->id;
+            target.parameterSetType = parent->type();
+            for (auto &function : device->functions) {
+              if (!function.second) continue;
+              auto parameterGroup = function.second->getParameterGroup(target.parameterSetType);
+              if (!parameterGroup || parameterGroup->parameters.find(target.parameterId) == parameterGroup->parameters.end()) continue;
+              target.validChannels.push_back((int32_t)function.first);
+            }
+            std::sort(target.validChannels.begin(), target.validChannels.end());
+            field.targets.push_back(std::move(target));
+          }
+        }
+
+        frame.fields.push_back(std::move(field));
+      }
+
+      _framesByRorg[packetIterator.first].frames.push_back(std::move(frame));
+    }
+
+    for (auto &rorgFrames : _framesByRorg) {
+      buildClassifier(rorgFrames.second);
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void DecodePlan::buildClassifier(RorgFrames &rorgFrames) {
+  //The key is the discriminator field most frames have in common.
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> fieldCounts;
+  for (auto &frame : rorgFrames.frames) {
+    std::set<std::pair<uint32_t, uint32_t>> frameFields;
+    for (auto &discriminator : frame.discriminators) {
+      frameFields.emplace(discriminator.bitIndex, discriminator.bitSize);
+    }
+    for (auto &field : frameFields) {
+      fieldCounts[field]++;
+    }
+  }
+
+  std::pair<uint32_t, uint32_t> key;
+  uint32_t keyCount = 0;
+  for (auto &fieldCount : fieldCounts) {
+    if (fieldCount.second > keyCount) {
+      key = fieldCount.first;
+      keyCount = fieldCount.second;
+    }
+  }
+  if (keyCount < 2) return;
+
+  rorgFrames.hasKey = true;
+  rorgFrames.keyBitIndex = key.first;
+  rorgFrames.keyBitSize = key.second;
+  for (uint32_t i = 0; i < rorgFrames.frames.size(); i++) {
+    auto &discriminators = rorgFrames.frames[i].discriminators;
+    auto keyIterator = std::find_if(discriminators.begin(), discriminators.end(), [&](const Discriminator &discriminator) { return discriminator.bitIndex == key.first && discriminator.bitSize == key.second; });
+    if (keyIterator == discriminators.end()) rorgFrames.unkeyedFrames.push_back(i);
+    else rorgFrames.framesByKey[keyIterator->value].push_back(i);
+  }
+}
+
+bool DecodePlan::matches(const Frame &frame, std::span<const uint8_t> data) {
+  uint32_t bitSize = data.size() * 8;
+  for (auto &discriminator : frame.discriminators) {
+    if (discriminator.bitIndex >= bitSize) continue;
+    if (getBits(data, discriminator.bitIndex, discriminator.bitSize) != discriminator.value) return false;
+  }
+  return true;
+}
+
+uint32_t DecodePlan::getBits(std::span<const uint8_t> data, uint32_t bitIndex, uint32_t bitSize) {
+  if (bitSize == 0 || bitSize > 32) return 0;
+  uint32_t firstByte = bitIndex / 8;
+  uint32_t lastByte = (bitIndex + bitSize - 1) / 8;
+  //At most 5 bytes, so the window never overflows.
+  uint64_t window = 0;
+  for (uint32_t i = firstByte; i <= lastByte; i++) {
+    window = (window << 8u) | (i < data.size() ? data[i] : 0);
+  }
+  uint32_t trailingBits = (lastByte + 1) * 8 - (bitIndex + bitSize);
+  return (uint32_t)((window >> trailingBits) & (0xFFFFFFFFu >> (32 - bitSize)));
+}
+
+std::vector<uint8_t> DecodePlan::toBinary(uint32_t value, uint32_t bitSize) {
+  std::vector<uint8_t> binary((bitSize + 7) / 8, 0);
+  for (uint32_t i = 0; i < binary.size(); i++) {
+    binary[binary.size() - 1 - i] = (uint8_t)(value >> (i * 8));
+  }
+  return binary;
+}
+
+}
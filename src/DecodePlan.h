@@ -0,0 +1,163 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef DECODEPLAN_H_
+#define DECODEPLAN_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * The frames of one device description in a form which can be matched against received telegrams without searching
+ * the description.
+ *
+ * Bit positions, channel masks, constant payloads and discriminators are taken from the frames once. The channels each
+ * associated variable exists in are resolved from the functions, so decoding only needs a binary search instead of
+ * looking up functions and parameter groups. Plans are shared by all peers of a device description (see get()).
+ */
+class DecodePlan {
+ public:
+  struct Target {
+    std::string parameterId;
+    BaseLib::DeviceDescription::ParameterGroup::Type::Enum parameterSetType = BaseLib::DeviceDescription::ParameterGroup::Type::Enum::none;
+    /**
+     * Channels whose parameter group of parameterSetType contains the parameter. Sorted.
+     */
+    std::vector<int32_t> validChannels;
+
+    bool isValidChannel(int32_t channel) const;
+  };
+
+  struct Field {
+    /**
+     * True when the value is read from the telegram, false for constant values.
+     */
+    bool inPacket = false;
+    uint32_t bitIndex = 0;
+    uint32_t bitSize = 0;
+    /**
+     * Values read from the telegram must equal this value, otherwise the frame doesn't match. -1 when the field is no
+     * discriminator.
+     */
+    int32_t constValue = -1;
+    /**
+     * The field is only a discriminator and sets no variables.
+     */
+    bool discriminatorOnly = false;
+    /**
+     * The value of constant fields.
+     */
+    std::vector<uint8_t> constData;
+    std::vector<Target> targets;
+  };
+
+  struct Discriminator {
+    uint32_t bitIndex = 0;
+    uint32_t bitSize = 0;
+    uint32_t value = 0;
+  };
+
+  struct Frame {
+    std::string id;
+    int32_t channelIndex = -1;
+    uint8_t channelMask = 0xFF;
+    int32_t channelIndexOffset = 0;
+    /**
+     * Channel from the description. -1: Read from the telegram. -2: All channels.
+     */
+    int32_t fixedChannel = -1;
+    std::vector<Field> fields;
+    /**
+     * The constant fields of up to 32 bits. They are checked by forEachMatchingFrame(), so decoding doesn't need to
+     * check them again.
+     */
+    std::vector<Discriminator> discriminators;
+  };
+
+  /**
+   * Returns the plan of a device description. Plans are compiled on first use and cached.
+   */
+  static std::shared_ptr<const DecodePlan> get(const BaseLib::DeviceDescription::PHomegearDevice &device);
+
+  explicit DecodePlan(const BaseLib::DeviceDescription::PHomegearDevice &device);
+
+  /**
+   * Compares by ownership, so a description reloaded to the address of an old one is not mistaken for it.
+   */
+  bool isFor(const BaseLib::DeviceDescription::PHomegearDevice &device) const { return device && !_device.owner_before(device) && !device.owner_before(_device); }
+
+  /**
+   * Calls "callback" for every frame of the RORG whose discriminators match the telegram, in the order of the device
+   * description. Discriminators starting behind the end of the telegram are ignored.
+   *
+   * Frames are preselected by the value of the discriminator most frames have in common (for VLD telegrams usually
+   * the command ID), so only frames with the right value or without this discriminator are compared.
+   */
+  template<typename Callback>
+  void forEachMatchingFrame(uint32_t rorg, std::span<const uint8_t> data, Callback &&callback) const {
+    auto rorgIterator = _framesByRorg.find(rorg);
+    if (rorgIterator == _framesByRorg.end()) return;
+    auto &rorgFrames = rorgIterator->second;
+    uint32_t bitSize = data.size() * 8;
+
+    if (!rorgFrames.hasKey || rorgFrames.keyBitIndex >= bitSize) {
+      for (auto &frame : rorgFrames.frames) {
+        if (matches(frame, data)) callback(frame);
+      }
+      return;
+    }
+
+    static const std::vector<uint32_t> noFrames;
+    auto keyedFramesIterator = rorgFrames.framesByKey.find(getBits(data, rorgFrames.keyBitIndex, rorgFrames.keyBitSize));
+    auto &keyedFrames = keyedFramesIterator == rorgFrames.framesByKey.end() ? noFrames : keyedFramesIterator->second;
+    auto &unkeyedFrames = rorgFrames.unkeyedFrames;
+    //Both lists are sorted, merging them keeps the order of the description.
+    auto keyed = keyedFrames.begin();
+    auto unkeyed = unkeyedFrames.begin();
+    while (keyed != keyedFrames.end() || unkeyed != unkeyedFrames.end()) {
+      uint32_t index;
+      if (unkeyed == unkeyedFrames.end() || (keyed != keyedFrames.end() && *keyed < *unkeyed)) index = *(keyed++);
+      else index = *(unkeyed++);
+      auto &frame = rorgFrames.frames[index];
+      if (matches(frame, data)) callback(frame);
+    }
+  }
+
+  /**
+   * Reads up to 32 bits. Bits are counted from the MSB of the first byte, bits behind the end of the data are 0.
+   */
+  static uint32_t getBits(std::span<const uint8_t> data, uint32_t bitIndex, uint32_t bitSize);
+
+  /**
+   * Converts a value read by getBits() to the right aligned byte array used for parameter data.
+   */
+  static std::vector<uint8_t> toBinary(uint32_t value, uint32_t bitSize);
+ private:
+  struct RorgFrames {
+    std::vector<Frame> frames;
+    bool hasKey = false;
+    uint32_t keyBitIndex = 0;
+    uint32_t keyBitSize = 0;
+    //Indexes into "frames" by the value of the key field. Sorted.
+    std::unordered_map<uint32_t, std::vector<uint32_t>> framesByKey;
+    //Frames without the key field. Sorted.
+    std::vector<uint32_t> unkeyedFrames;
+  };
+
+  std::weak_ptr<BaseLib::DeviceDescription::HomegearDevice> _device;
+  std::unordered_map<uint32_t, RorgFrames> _framesByRorg;
+
+  static bool matches(const Frame &frame, std::span<const uint8_t> data);
+  static void buildClassifier(RorgFrames &rorgFrames);
+};
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "DuplicateFilter.h"
+
+#include "Gd.h"
+
+#include <algorithm>
+
+namespace EnOcean {
+
+DuplicateFilter::Result DuplicateFilter::check(const std::string &interfaceId, const PEnOceanPacket &packet) {
+  try {
+    uint32_t window = _window;
+    if (window == 0 || !packet) return Result::original;
+
+    //The data ends with sender address and status byte. Leave out the repeater count in the lower nibble of the status
+    //byte, the upper nibble contains the T21 and NU bits of RPS telegrams.
+    auto data = packet->getDataView();
+    if (data.size() < 2) return Result::original;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < data.size() - 1; i++) {
+      hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    hash = (hash ^ (data.back() & 0xF0u)) * 1099511628211ull;
+    uint64_t copy = std::hash<std::string>()(interfaceId) ^ (data.back() & 0x0Fu);
+
+    int64_t time = packet->getTimeReceived();
+    if (time == 0) time = BaseLib::HelperFunctions::getTime();
+
+    int32_t senderAddress = packet->senderAddress();
+    std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+    auto &entry = _entries[((uint32_t)senderAddress * 2654435761u) >> 24u];
+    if (entry.senderAddress != senderAddress || entry.hash != hash || entry.copies.empty() || time - entry.time > window ||
+        std::find(entry.copies.begin(), entry.copies.end(), copy) != entry.copies.end()) {
+      //A new telegram of this sender.
+      entry.senderAddress = senderAddress;
+      entry.hash = hash;
+      entry.time = time;
+      entry.bestRssi = packet->getRssi();
+      entry.copies.clear();
+      entry.copies.push_back(copy);
+      return Result::original;
+    }
+
+    entry.copies.push_back(copy);
+    _duplicateCounts[interfaceId]++;
+    if (packet->getRssi() > entry.bestRssi) {
+      entry.bestRssi = packet->getRssi();
+      return Result::betterDuplicate;
+    }
+    return Result::duplicate;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Result::original;
+}
+
+std::unordered_map<std::string, uint64_t> DuplicateFilter::getDuplicateCounts() {
+  std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+  return _duplicateCounts;
+}
+
+}
@@ -0,0 +1,71 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef DUPLICATEFILTER_H_
+#define DUPLICATEFILTER_H_
+
+#include "EnOceanPacket.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Recognizes copies of the same telegram received through several interfaces or repeaters within a short time window.
+ *
+ * A telegram is only a copy when it equals the sender's immediately preceding telegram and arrived through another
+ * interface or with another repeater count than all copies before. Telegrams are compared by a hash over sender,
+ * payload and status byte without the repeater count. A sender repeating a telegram itself (e. g. a rocker pressed
+ * twice) is not filtered, as the new telegram arrives with an interface and repeater count already seen.
+ */
+class DuplicateFilter {
+ public:
+  enum class Result {
+    original,
+    duplicate,
+    /**
+     * A duplicate with a better RSSI than all copies received before.
+     */
+    betterDuplicate
+  };
+
+  /**
+   * @param window Time window in milliseconds. 0 disables the filter.
+   */
+  explicit DuplicateFilter(uint32_t window = 500) : _window(window) {}
+
+  void setWindow(uint32_t value) { _window = value; }
+  uint32_t getWindow() const { return _window; }
+
+  Result check(const std::string &interfaceId, const PEnOceanPacket &packet);
+
+  /**
+   * Returns the number of duplicates received per interface.
+   */
+  std::unordered_map<std::string, uint64_t> getDuplicateCounts();
+ private:
+  struct Entry {
+    int32_t senderAddress = 0;
+    uint64_t hash = 0;
+    int64_t time = 0;
+    int32_t bestRssi = 0;
+    /**
+     * Interface and repeater count of every copy received. Hash of the interface ID XORed with the repeater count.
+     */
+    std::vector<uint64_t> copies;
+  };
+
+  std::atomic<uint32_t> _window{500};
+  std::mutex _entriesMutex;
+  //The last telegram of each sender, indexed by a hash of the sender address. Colliding senders replace each other.
+  std::array<Entry, 256> _entries;
+  std::unordered_map<std::string, uint64_t> _duplicateCounts;
+};
+
+}
+
+#endif
@@ -3,6 +3,10 @@
 #include "EnOceanCentral.h"
 #include "Gd.h"
 #include "EnOceanPackets.h"
+#include "Log.h"
+#include "PhysicalInterfaces/Esp3Codec.h"
+#include "Security.h"
+#include "SecurityBenchmark.h"
 
 #include <homegear-base/HelperFunctions/Ha.h>
 
@@ -37,6 +41,13 @@ void EnOceanCentral::dispose(bool wait) {
       _bl->threadManager.join(_updateFirmwareThread);
     }
 
+    _stopDispatchThreads = true;
+    for (auto &shard: _dispatchShards) {
+      shard->signal++;
+      shard->signal.notify_all();
+      _bl->threadManager.join(shard->thread);
+    }
+
     _stopWorkerThread = true;
     Gd::out.printDebug("Debug: Waiting for worker thread of device " + std::to_string(_deviceId) + "...");
     _bl->threadManager.join(_workerThread);
@@ -45,11 +56,20 @@ void EnOceanCentral::dispose(bool wait) {
     Gd::out.printDebug("Removing device " + std::to_string(_deviceId) + " from physical device's event queue...");
     Gd::interfaces->removeEventHandlers();
 
+    {
+      std::lock_guard<std::mutex> peersGuard(_peersMutex);
+      for (auto &peer: _peersById) {
+        auto myPeer = std::dynamic_pointer_cast<EnOceanPeer>(peer.second);
+        if (myPeer) myPeer->flushPendingWrites();
+      }
+    }
+
     _wildcardPeers.clear();
     _peersById.clear();
     _peersBySerial.clear();
     _peers.clear();
-    _sniffedPackets.clear();
+    _peerAddressIndex.store(std::make_shared<const PeerAddressIndex>());
+    _sniffer.stop();
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -86,6 +106,13 @@ void EnOceanCentral::init() {
                                                        this,
                                                        std::placeholders::_1,
                                                        std::placeholders::_2)));
+    _localRpcMethods.insert(std::pair<std::string, std::function<BaseLib::PVariable(
+        const BaseLib::PRpcClientInfo &clientInfo,
+        const BaseLib::PArray &parameters)>>("getSniffedPackets",
+                                             std::bind(&EnOceanCentral::getSniffedPackets,
+                                                       this,
+                                                       std::placeholders::_1,
+                                                       std::placeholders::_2)));
     _localRpcMethods.insert(std::pair<std::string, std::function<BaseLib::PVariable(
         const BaseLib::PRpcClientInfo &clientInfo,
         const BaseLib::PArray &parameters)>>("queryFirmwareVersion",
@@ -192,6 +219,35 @@ void EnOceanCentral::init() {
                                                        std::placeholders::_1,
                                                        std::placeholders::_2)));
 
+    Gd::settings.refresh();
+
+    {
+      auto queueSizeSetting = Gd::family->getFamilySetting("rxQueueSize");
+      uint32_t queueSize = queueSizeSetting && queueSizeSetting->integerValue > 0 ? (uint32_t)queueSizeSetting->integerValue : 1000;
+
+      auto dropPolicySetting = Gd::family->getFamilySetting("rxQueueDropPolicy");
+      _dropPolicy = dropPolicySetting && BaseLib::HelperFunctions::toLower(dropPolicySetting->stringValue) == "newest" ? DropPolicy::dropNewest : DropPolicy::dropOldest;
+
+      auto duplicateWindowSetting = Gd::family->getFamilySetting("duplicateWindow");
+      if (duplicateWindowSetting && duplicateWindowSetting->integerValue >= 0) _duplicateFilter.setWindow((uint32_t)duplicateWindowSetting->integerValue);
+
+      auto workerThreadsSetting = Gd::family->getFamilySetting("rxWorkerThreads");
+      uint32_t workerThreads = workerThreadsSetting && workerThreadsSetting->integerValue > 0 ? (uint32_t)workerThreadsSetting->integerValue : 1;
+      if (workerThreads > 64) workerThreads = 64;
+
+      _stopDispatchThreads = false;
+      _dispatchShards.reserve(workerThreads);
+      for (uint32_t i = 0; i < workerThreads; i++) {
+        _dispatchShards.emplace_back(std::make_unique<DispatchShard>(queueSize));
+      }
+      //Every packet waiting in a receive queue keeps its pool slot busy. The headroom covers packets being processed or
+      //kept by the sniffer and responses.
+      Gd::interfaces->setPacketPoolSize(queueSize * workerThreads + 64);
+      for (auto &shard: _dispatchShards) {
+        Gd::bl->threadManager.start(shard->thread, true, _bl->settings.workerThreadPriority(), _bl->settings.workerThreadPolicy(), &EnOceanCentral::dispatchWorker, this, shard.get());
+      }
+    }
+
     Gd::interfaces->addEventHandlers((BaseLib::Systems::IPhysicalInterface::IPhysicalInterfaceEventSink *)
                                          this);
 
@@ -214,11 +270,17 @@ void EnOceanCentral::worker() {
       Gd::out.printMessage("Info: Not starting updates, because manually set firmware installation time is too far in the past (" + std::to_string(_firmwareInstallationTime) + ").");
       nextFirmwareUpdateCheck = 0; //Do not continue after 4,5 h
     }
+    int64_t lastSettingsRefresh = BaseLib::HelperFunctions::getTime();
 
     while (!_stopWorkerThread && !Gd::bl->shuttingDown) {
       try {
         std::this_thread::sleep_for(sleepingTime);
         if (_stopWorkerThread || Gd::bl->shuttingDown) return;
+        if (BaseLib::HelperFunctions::getTime() - lastSettingsRefresh >= 10000) {
+          //Settings changed at runtime take effect on the receive path within ten seconds.
+          lastSettingsRefresh = BaseLib::HelperFunctions::getTime();
+          Gd::settings.refresh();
+        }
         if (counter > 1000) {
           counter = 0;
 
@@ -536,6 +598,7 @@ void EnOceanCentral::loadPeers() {
         _wildcardPeers[peer->getAddress()].push_back(peer);
       }
     }
+    updatePeerAddressIndex();
 
     //Peers need to be loaded for ping worker to start
     Gd::bl->threadManager.start(_pingWorkerThread, true, _bl->settings.workerThreadPriority(), _bl->settings.workerThreadPolicy(), &EnOceanCentral::pingWorker, this);
@@ -581,6 +644,43 @@ std::shared_ptr<EnOceanPeer> EnOceanCentral::getPeer(uint64_t id) {
   return std::shared_ptr<EnOceanPeer>();
 }
 
+const std::vector<PMyPeer> *EnOceanCentral::PeerAddressIndex::find(int32_t senderAddress) const {
+  auto peersIterator = peers.find(senderAddress);
+  if (peersIterator != peers.end()) return &peersIterator->second;
+  if (wildcardPeers.empty()) return nullptr;
+  peersIterator = wildcardPeers.find(senderAddress & 0xFFFFFF80);
+  if (peersIterator != wildcardPeers.end()) return &peersIterator->second;
+  return nullptr;
+}
+
+void EnOceanCentral::updatePeerAddressIndex() {
+  try {
+    //Serializes rebuilds, so an older index can't replace a newer one.
+    std::lock_guard<std::mutex> peerAddressIndexGuard(_peerAddressIndexMutex);
+    auto peerAddressIndex = std::make_shared<PeerAddressIndex>();
+    {
+      std::lock_guard<std::mutex> peersGuard(_peersMutex);
+      peerAddressIndex->peers.reserve(_peers.size());
+      for (auto &peers: _peers) {
+        if (peers.second.empty()) continue;
+        peerAddressIndex->peers.emplace(peers.first, std::vector<PMyPeer>(peers.second.begin(), peers.second.end()));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> wildcardPeersGuard(_wildcardPeersMutex);
+      peerAddressIndex->wildcardPeers.reserve(_wildcardPeers.size());
+      for (auto &peers: _wildcardPeers) {
+        if (peers.second.empty()) continue;
+        peerAddressIndex->wildcardPeers.emplace(peers.first, std::vector<PMyPeer>(peers.second.begin(), peers.second.end()));
+      }
+    }
+    _peerAddressIndex.store(std::move(peerAddressIndex));
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
 std::list<PMyPeer> EnOceanCentral::getPeer(int32_t address) {
   try {
     std::lock_guard<std::mutex> peersGuard(_peersMutex);
@@ -651,10 +751,90 @@ int32_t EnOceanCentral::getFreeRfChannel(const std::string &interfaceId) {
 }
 
 bool EnOceanCentral::onPacketReceived(std::string &senderId, std::shared_ptr<BaseLib::Systems::Packet> packet) {
+  try {
+    if (_disposing || _dispatchShards.empty()) return false;
+    ReceivedPacket receivedPacket{senderId, std::dynamic_pointer_cast<EnOceanPacket>(packet)};
+    if (!receivedPacket.packet) return false;
+
+    auto duplicateResult = _duplicateFilter.check(senderId, receivedPacket.packet);
+    if (duplicateResult == DuplicateFilter::Result::duplicate) return false;
+    receivedPacket.roamingOnly = duplicateResult == DuplicateFilter::Result::betterDuplicate;
+
+    auto &shard = _dispatchShards.size() == 1 ? _dispatchShards.front() : _dispatchShards.at(getDispatchShardIndex(receivedPacket.packet->senderAddress()));
+
+    //Never block the listen thread. When the queue is full, drop according to the configured policy.
+    while (!shard->packets.tryPush(receivedPacket)) {
+      uint64_t droppedPacketCount = ++_droppedPacketCount;
+      Log::repeatedWarning(Gd::out, Log::RepeatedMessage::packetQueueFull, 0, [&]() { return "Warning: Packet queue is full. Packet processing is too slow. Dropped packets so far: " + std::to_string(droppedPacketCount); });
+      if (_dropPolicy == DropPolicy::dropNewest) return false;
+      ReceivedPacket oldestPacket;
+      shard->packets.tryPop(oldestPacket);
+    }
+    _queuedPacketCount++;
+    shard->signal++;
+    shard->signal.notify_one();
+    return true;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+uint32_t EnOceanCentral::getDispatchShardIndex(int32_t senderAddress) {
+  try {
+    //Packets for wildcard peers come from up to 128 addresses. They must all end up in the same shard.
+    uint32_t shardKey = (uint32_t)senderAddress;
+    auto peerAddressIndex = _peerAddressIndex.load();
+    if (!peerAddressIndex->wildcardPeers.empty() && peerAddressIndex->wildcardPeers.find(senderAddress & 0xFFFFFF80) != peerAddressIndex->wildcardPeers.end()) shardKey &= 0xFFFFFF80;
+    //Mix the bits, as consecutive addresses are common.
+    shardKey ^= shardKey >> 16u;
+    shardKey *= 0x45D9F3Bu;
+    shardKey ^= shardKey >> 16u;
+    return shardKey % _dispatchShards.size();
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return 0;
+}
+
+void EnOceanCentral::dispatchWorker(DispatchShard *shard) {
+  try {
+    ReceivedPacket receivedPacket;
+    while (!_stopDispatchThreads) {
+      try {
+        //Read the signal before checking the queue, so a push between tryPop() and wait() is not missed.
+        uint32_t signal = shard->signal.load();
+        if (!shard->packets.tryPop(receivedPacket)) {
+          shard->signal.wait(signal);
+          continue;
+        }
+        if (receivedPacket.roamingOnly) {
+          auto peerAddressIndex = _peerAddressIndex.load();
+          auto peers = peerAddressIndex->find(receivedPacket.packet->senderAddress());
+          if (peers) {
+            for (auto &peer: *peers) {
+              updateRoaming(receivedPacket.interfaceId, receivedPacket.packet, peer);
+            }
+          }
+        } else processPacket(receivedPacket.interfaceId, receivedPacket.packet);
+        receivedPacket.packet.reset();
+        shard->processedPacketCount++;
+      }
+      catch (const std::exception &ex) {
+        Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+      }
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool EnOceanCentral::processPacket(std::string &senderId, PEnOceanPacket &myPacket) {
   try {
     if (_disposing) return false;
-    PEnOceanPacket myPacket(std::dynamic_pointer_cast<EnOceanPacket>(packet));
-    if (!myPacket) return false;
 
     if (_bl->debugLevel >= 4) {
       std::string repeatingStatus;
@@ -670,9 +850,11 @@ bool EnOceanCentral::onPacketReceived(std::string &senderId, std::shared_ptr<Bas
     }
 
     if (myPacket->getRorg() == 0xD1) {
-      auto data = myPacket->getData();
-      if (data.at(1) == 0x03 && (data.at(2) == 0x32 || data.at(2) == 0x33)) {
+      auto data = myPacket->getDataView();
+      if (data.size() >= 3 && data[1] == 0x03 && (data.at(2) == 0x32 || data.at(2) == 0x33)) {
         if (!_updatingFirmware) { //When we are updating, we are receiving our own repeated packets.
+          //Update packets of several senders can be processed by different dispatch workers at the same time.
+          std::lock_guard<std::mutex> foreignFirmwareUpdateGuard(_foreignFirmwareUpdateMutex);
           Gd::out.printInfo("Info: Update packet received from other central. Blocking firmware updates for 1 hour.");
           _lastForeignFirmwareUpdatePacket = BaseLib::HelperFunctions::getTime();
           saveVariable(1, _lastForeignFirmwareUpdatePacket);
@@ -680,24 +862,11 @@ bool EnOceanCentral::onPacketReceived(std::string &senderId, std::shared_ptr<Bas
       }
     }
 
-    std::list<PMyPeer> peers = getPeer(myPacket->senderAddress());
-    if (peers.empty()) {
-      std::lock_guard<std::mutex> wildcardPeersGuard(_wildcardPeersMutex);
-      auto wildcardPeersIterator = _wildcardPeers.find(myPacket->senderAddress() & 0xFFFFFF80);
-      if (wildcardPeersIterator != _wildcardPeers.end()) peers = wildcardPeersIterator->second;
-    }
-    if (peers.empty()) {
-      if (_sniff) {
-        std::lock_guard<std::mutex> sniffedPacketsGuard(_sniffedPacketsMutex);
-        auto sniffedPacketsIterator = _sniffedPackets.find(myPacket->senderAddress());
-        if (sniffedPacketsIterator == _sniffedPackets.end()) {
-          _sniffedPackets[myPacket->senderAddress()].reserve(100);
-          _sniffedPackets[myPacket->senderAddress()].push_back(myPacket);
-        } else {
-          if (sniffedPacketsIterator->second.size() + 1 > sniffedPacketsIterator->second.capacity()) sniffedPacketsIterator->second.reserve(sniffedPacketsIterator->second.capacity() + 100);
-          sniffedPacketsIterator->second.push_back(myPacket);
-        }
-      }
+    //The snapshot keeps the peers alive while the packet is processed.
+    auto peerAddressIndex = _peerAddressIndex.load();
+    auto peers = peerAddressIndex->find(myPacket->senderAddress());
+    if (!peers) {
+      if (_sniffer.isRunning()) _sniffer.addPacket(myPacket);
 
       PairingData pairingData;
 
@@ -713,16 +882,8 @@ bool EnOceanCentral::onPacketReceived(std::string &senderId, std::shared_ptr<Bas
 
     bool result = false;
     bool unpaired = true;
-    for (auto &peer: peers) {
-      auto roamingSetting = Gd::family->getFamilySetting("roaming");
-      bool roaming = !roamingSetting || roamingSetting->integerValue;
-      if (roaming && senderId != peer->getPhysicalInterfaceId() && peer->getPhysicalInterface()->getBaseAddress() == Gd::interfaces->getInterface(senderId)->getBaseAddress()) {
-        if (myPacket->getRssi() > peer->getPhysicalInterface()->getRssi(peer->getAddress(), peer->isWildcardPeer()) + 6) {
-          peer->getPhysicalInterface()->decrementRssi(peer->getAddress(), peer->isWildcardPeer()); //Reduce RSSI on current peer's interface in case it is not receiving any packets from this peer anymore
-          Gd::out.printInfo("Info: Setting physical interface of peer " + std::to_string(peer->getID()) + " to " + senderId + ", because the RSSI is better.");
-          peer->setPhysicalInterfaceId(senderId);
-        } else peer->getPhysicalInterface()->decrementRssi(peer->getAddress(), peer->isWildcardPeer()); //Reduce RSSI on current peer's interface in case it is not receiving any packets from this peer anymore
-      }
+    for (auto &peer: *peers) {
+      updateRoaming(senderId, myPacket, peer);
       if ((peer->getDeviceType() >> 16) == myPacket->getRorg()) unpaired = false;
 
       peer->packetReceived(myPacket);
@@ -746,6 +907,25 @@ bool EnOceanCentral::onPacketReceived(std::string &senderId, std::shared_ptr<Bas
   return false;
 }
 
+void EnOceanCentral::updateRoaming(const std::string &senderId, const PEnOceanPacket &packet, const PMyPeer &peer) {
+  try {
+    if (!Gd::settings.roaming()) return;
+    //Handles resolve without string lookups or locks. Handle 0 (no interface set) resolves to the default interface.
+    auto senderInterface = Gd::interfaces->getInterfaceByHandle(packet->getInterfaceHandle());
+    auto currentInterface = peer->getPhysicalInterface();
+    if (senderInterface != currentInterface && currentInterface->getBaseAddress() == senderInterface->getBaseAddress()) {
+      //The RSSI stored by the current interface decays over time, so it loses the peer when it doesn't receive it anymore.
+      if (packet->getRssi() > currentInterface->getRssi(peer->getAddress(), peer->isWildcardPeer()) + 6) {
+        Gd::out.printInfo("Info: Setting physical interface of peer " + std::to_string(peer->getID()) + " to " + senderId + ", because the RSSI is better.");
+        peer->setPhysicalInterfaceId(senderId);
+      }
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
 std::string EnOceanCentral::getFreeSerialNumber(int32_t address) {
   std::string serial;
   int32_t i = 0;
@@ -797,9 +977,9 @@ bool EnOceanCentral::handlePairingRequest(const std::string &interfaceId, const
                   peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>(true), true);
                 }
               } else {
-                auto peer = buildPeer(pairingData.eep, packet->senderAddress(), interfaceId, true, _pairingData.rfChannel);
+                auto peer = buildPeer(pairingData.eep, packet->senderAddress(), interfaceId, true, pairingData.rfChannel);
                 if (peer) {
-                  auto result = peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)_pairingData.rfChannel), true);
+                  auto result = peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)pairingData.rfChannel), true);
                   if (result->errorStruct) {
                     auto peerId = peer->getID();
                     peer.reset();
@@ -807,9 +987,9 @@ bool EnOceanCentral::handlePairingRequest(const std::string &interfaceId, const
                     return false;
                   }
                   std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                  peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)_pairingData.rfChannel), true);
+                  peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)pairingData.rfChannel), true);
                   std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                  peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)_pairingData.rfChannel), true);
+                  peer->setValue(std::make_shared<RpcClientInfo>(), 1, "PAIRING", std::make_shared<BaseLib::Variable>((int32_t)pairingData.rfChannel), true);
                 }
               }
             }
@@ -920,6 +1100,7 @@ bool EnOceanCentral::handlePairingRequest(const std::string &interfaceId, const
           _peers[peer->getAddress()].push_back(peer);
           _peersById[peer->getID()] = peer;
           peersGuard.unlock();
+          updatePeerAddressIndex();
         }
         catch (const std::exception &ex) {
           Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -1060,6 +1241,7 @@ void EnOceanCentral::deletePeer(uint64_t id) {
         if (peerIterator->second.empty()) _peers.erase(peerIterator);
       }
     }
+    updatePeerAddressIndex();
 
     int32_t i = 0;
     while (peer.use_count() > 1 && i < 600) {
@@ -1095,6 +1277,9 @@ std::string EnOceanCentral::handleCliCommand(std::string command) {
       stringStream << "peers setname (pn)         Name a peer" << std::endl;
       stringStream << "interface setaddress (ia)  Set the base address of an EnOcean interface" << std::endl;
       stringStream << "process packet (pp)        Simulate reception of a packet" << std::endl;
+      stringStream << "statistics (st)            Show packet processing statistics" << std::endl;
+      stringStream << "benchmark (bm)             Measure the speed of internal algorithms" << std::endl;
+      stringStream << "security test (sect)       Test the secure telegram implementation" << std::endl;
       stringStream << "unselect (u)               Unselect this device" << std::endl;
       return stringStream.str();
     } else if (BaseLib::HelperFunctions::checkCliCommand(command, "pairing on", "pon", "", 0, arguments, showHelp)) {
@@ -1165,6 +1350,7 @@ std::string EnOceanCentral::handleCliCommand(std::string command) {
             std::lock_guard<std::mutex> wildcardPeersGuard(_wildcardPeersMutex);
             _wildcardPeers[peer->getAddress()].push_back(peer);
           }
+          updatePeerAddressIndex();
         }
         catch (const std::exception &ex) {
           _peersMutex.unlock();
@@ -1428,10 +1614,121 @@ std::string EnOceanCentral::handleCliCommand(std::string command) {
       std::vector<uint8_t> rawPacket = BaseLib::HelperFunctions::getUBinary(arguments.at(1));
       PEnOceanPacket packet = std::make_shared<EnOceanPacket>(rawPacket);
       if (packet->getType() == EnOceanPacket::Type::RADIO_ERP1 || packet->getType() == EnOceanPacket::Type::RADIO_ERP2) {
-        onPacketReceived(interfaceId, packet);
-        stringStream << "Processed packet " << BaseLib::HelperFunctions::getHexString(packet->getBinary()) << std::endl;
+        //Packets are processed asynchronously by the dispatch workers.
+        if (onPacketReceived(interfaceId, packet)) stringStream << "Queued packet " << BaseLib::HelperFunctions::getHexString(packet->getBinary()) << " for processing." << std::endl;
+        else stringStream << "Packet " << BaseLib::HelperFunctions::getHexString(packet->getBinary()) << " was not queued (duplicate or queue full)." << std::endl;
+      }
+
+      return stringStream.str();
+    } else if (BaseLib::HelperFunctions::checkCliCommand(command, "statistics", "st", "", 0, arguments, showHelp)) {
+      if (showHelp) {
+        stringStream << "Description: This command shows packet processing and transmit queue statistics." << std::endl;
+        stringStream << "Usage: statistics" << std::endl << std::endl;
+        stringStream << "Parameters:" << std::endl;
+        stringStream << "  There are no parameters." << std::endl;
+        return stringStream.str();
       }
 
+      stringStream << "Received packet queue:" << std::endl;
+      stringStream << "  Queued packets:  " << _queuedPacketCount << std::endl;
+      stringStream << "  Dropped packets: " << _droppedPacketCount << " (policy: " << (_dropPolicy == DropPolicy::dropNewest ? "newest" : "oldest") << ")" << std::endl;
+      for (uint32_t i = 0; i < _dispatchShards.size(); i++) {
+        auto &shard = _dispatchShards.at(i);
+        stringStream << "  Worker " << i << ":        " << shard->processedPacketCount << " processed, " << shard->packets.size() << " of " << shard->packets.capacity() << " queued" << std::endl;
+      }
+      stringStream << "Duplicate telegrams (window: " << _duplicateFilter.getWindow() << " ms):" << std::endl;
+      auto duplicateCounts = _duplicateFilter.getDuplicateCounts();
+      if (duplicateCounts.empty()) stringStream << "  None" << std::endl;
+      for (auto &duplicateCount: duplicateCounts) {
+        stringStream << "  " << duplicateCount.first << ": " << duplicateCount.second << std::endl;
+      }
+      if (_sniffer.isRunning()) {
+        auto snifferStatistics = _sniffer.getStatistics();
+        stringStream << "Sniffer:" << std::endl;
+        stringStream << "  Telegrams: " << snifferStatistics.telegrams << " (buffer size: " << snifferStatistics.bufferSize << "), senders: " << snifferStatistics.senders << std::endl;
+        stringStream << "  Capture:   " << snifferStatistics.captureBytes << " bytes written, " << snifferStatistics.captureDropped << " telegrams dropped" << std::endl;
+      }
+      for (auto &interface: Gd::interfaces->getInterfaces()) {
+        stringStream << "Packet pool of \"" << interface->getID() << "\": " << interface->getPacketPoolSize() << " slots, " << interface->getPacketPoolFallbackCount() << " fallback allocations" << std::endl;
+      }
+      static const std::array<std::string, TxScheduler::priorityCount> laneNames{"Interactive:  ", "Configuration:", "Firmware:     "};
+      for (auto &interface: Gd::interfaces->getInterfaces()) {
+        auto txStatistics = interface->getTxStatistics();
+        stringStream << "TX scheduler of \"" << interface->getID() << "\" (remaining airtime: " << (txStatistics.remainingAirtime / 1000) << " of " << (txStatistics.budget / 1000) << " ms per hour):" << std::endl;
+        stringStream << "  Duty cycle used: " << interface->getDutyCycleInfo().dutyCycleUsed << " % (estimated)" << std::endl;
+        for (uint32_t i = 0; i < TxScheduler::priorityCount; i++) {
+          auto &lane = txStatistics.lanes.at(i);
+          stringStream << "  " << laneNames.at(i) << " " << lane.queued << " queued, " << lane.sent << " sent, " << lane.dropped << " dropped, wait time " << lane.averageWaitTime << " ms average, " << lane.maxWaitTime << " ms max" << std::endl;
+        }
+      }
+
+      return stringStream.str();
+    } else if (BaseLib::HelperFunctions::checkCliCommand(command, "security test", "sect", "", 0, arguments, showHelp)) {
+      if (showHelp) {
+        stringStream << "Description: This command checks CMAC calculation, rolling code handling and encryption of secure telegrams against known-answer vectors (RFC 4493, SP 800-38A) and libgcrypt." << std::endl;
+        stringStream << "Usage: security test" << std::endl;
+        return stringStream.str();
+      }
+
+      auto result = SecurityBenchmark::runKnownAnswerTests();
+      stringStream << "Passed: " << result.passed << ", failed: " << result.failures.size() << std::endl;
+      for (auto &failure : result.failures) {
+        stringStream << "  Failed: " << failure << std::endl;
+      }
+      return stringStream.str();
+    } else if (BaseLib::HelperFunctions::checkCliCommand(command, "benchmark", "bm", "", 1, arguments, showHelp)) {
+      if (showHelp) {
+        stringStream << "Description: This command measures the speed of internal algorithms on this machine." << std::endl;
+        stringStream << "Usage: benchmark TYPE [ROUNDS] [THREADS]" << std::endl << std::endl;
+        stringStream << "Parameters:" << std::endl;
+        stringStream << "  TYPE:    The algorithm to benchmark. One of \"crc\", \"rlc\" (rolling code window search), \"aes\" (secure telegrams) or \"security\" (verification and encryption of secure telegrams)." << std::endl;
+        stringStream << "  ROUNDS:  Optional number of rounds. Default: 100" << std::endl;
+        stringStream << "  THREADS: Optional number of concurrent threads for \"security\". Default: Number of CPU cores, at least 2 and at most 64" << std::endl;
+        return stringStream.str();
+      }
+
+      std::string type = BaseLib::HelperFunctions::toLower(arguments.at(0));
+      uint32_t rounds = arguments.size() > 1 ? BaseLib::Math::getUnsignedNumber(arguments.at(1)) : 100;
+      if (rounds == 0) rounds = 100;
+
+      if (type == "crc") {
+        auto result = Esp3Codec::benchmark(1000, rounds);
+        if (result.frames == 0) return "Benchmark failed.\n";
+        stringStream << "Validated " << result.frames << " ESP3 frames (" << result.bytes << " bytes):" << std::endl;
+        stringStream << "  Byte-wise loop: " << (result.bytewiseNanoseconds / result.frames) << " ns/frame" << std::endl;
+        stringStream << "  Slicing-by-4:   " << (result.slicedNanoseconds / result.frames) << " ns/frame" << std::endl;
+        stringStream << "  Batch API:      " << (result.batchNanoseconds / result.frames) << " ns/frame" << std::endl;
+      } else if (type == "rlc") {
+        auto result = SecurityBenchmark::runWindowSearch(rounds * 10);
+        if (result.telegrams == 0) return "Benchmark failed.\n";
+        stringStream << "Verified " << result.telegrams << " telegrams matching none of the " << Security::rollingCodeWindow << " rolling codes of the window (worst case):" << std::endl;
+        stringStream << "  Sequential: " << (result.sequentialNanoseconds / result.telegrams) << " ns/telegram" << std::endl;
+        stringStream << "  Batched:    " << (result.batchedNanoseconds / result.telegrams) << " ns/telegram" << std::endl;
+      } else if (type == "aes") {
+        auto results = SecurityBenchmark::runBackends(rounds * 100);
+        if (results.empty()) return "Benchmark failed.\n";
+        auto backend = Gd::settings.aesBackend();
+        auto usedImplementation = backend == SettingsCache::AesBackend::gcrypt ? Aes128::Implementation::none : Aes128::select(backend == SettingsCache::AesBackend::native);
+        stringStream << "Calculated CMACs of and encrypted secure telegrams (4 byte rolling code, 4 byte CMAC):" << std::endl;
+        for (auto &result : results) {
+          std::string name = Aes128::getName(result.implementation) + (result.implementation == usedImplementation ? " (used):" : ":");
+          stringStream << "  " << std::left << std::setw(18) << name << std::right;
+          if (result.telegrams == 0) stringStream << "Failed" << std::endl;
+          else stringStream << "CMAC " << (result.cmacNanoseconds / result.telegrams) << " ns/telegram, encryption " << (result.encryptNanoseconds / result.telegrams) << " ns/telegram" << std::endl;
+        }
+      } else if (type == "security") {
+        uint32_t threads = arguments.size() > 2 ? BaseLib::Math::getUnsignedNumber(arguments.at(2)) : std::min(64u, std::max(2u, std::thread::hardware_concurrency()));
+        if (threads == 0 || threads > 64) return "Invalid number of threads. The number of threads has to be between 1 and 64.\n";
+        auto results = SecurityBenchmark::run(rounds * 100, threads);
+        if (results.empty()) return "Benchmark failed.\n";
+        stringStream << "Verified and encrypted secure telegrams with 4 data bytes (average time per telegram and thread):" << std::endl;
+        for (auto &result : results) {
+          stringStream << "  RLC " << result.rollingCodeSize << " bytes, CMAC " << result.cmacSize << " bytes, " << std::setw(2) << result.threads << (result.threads == 1 ? " thread:  " : " threads: ");
+          if (result.telegrams == 0) stringStream << "Failed" << std::endl;
+          else stringStream << "explicit RLC " << (result.verifyExplicitNanoseconds / result.telegrams) << " ns, implicit RLC " << (result.verifyImplicitNanoseconds / result.telegrams) << " ns, encryption " << (result.encryptNanoseconds / result.telegrams) << " ns" << std::endl;
+        }
+      } else return "Unknown benchmark type.\n";
+
       return stringStream.str();
     } else return "Unknown command.\n";
   }
@@ -1497,6 +1794,7 @@ std::shared_ptr<EnOceanPeer> EnOceanCentral::buildPeer(uint64_t eep, int32_t add
       _peers[peer->getAddress()].push_back(peer);
       _peersById[peer->getID()] = peer;
       peersGuard.unlock();
+      updatePeerAddressIndex();
     }
     catch (const std::exception &ex) {
       Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -1673,6 +1971,7 @@ PVariable EnOceanCentral::createDevice(BaseLib::PRpcClientInfo clientInfo, int32
       std::lock_guard<std::mutex> wildcardPeersGuard(_wildcardPeersMutex);
       _wildcardPeers[peer->getAddress()].push_back(peer);
     }
+    updatePeerAddressIndex();
 
     PVariable deviceDescriptions(new Variable(VariableType::tArray));
     deviceDescriptions->arrayValue = peer->getDeviceDescriptions(clientInfo, true, std::map<std::string, bool>());
@@ -1878,26 +2177,30 @@ PVariable EnOceanCentral::getPairingState(BaseLib::PRpcClientInfo clientInfo) {
 
 PVariable EnOceanCentral::getSniffedDevices(BaseLib::PRpcClientInfo clientInfo) {
   try {
+    //Only the last telegrams of each sender are returned. Use the family method "getSniffedPackets" to page through all
+    //buffered telegrams.
+    auto summaries = _sniffer.getSenderSummaries();
     PVariable array(new Variable(VariableType::tArray));
-
-    std::lock_guard<std::mutex> sniffedPacketsGuard(_sniffedPacketsMutex);
-    array->arrayValue->reserve(_sniffedPackets.size());
-    for (auto peerPackets: _sniffedPackets) {
+    array->arrayValue->reserve(summaries.size());
+    for (auto &summary: summaries) {
       PVariable info(new Variable(VariableType::tStruct));
       array->arrayValue->push_back(info);
 
       info->structValue->insert(StructElement("FAMILYID", std::make_shared<Variable>(MY_FAMILY_ID)));
-      info->structValue->insert(StructElement("ADDRESS", std::make_shared<Variable>(peerPackets.first)));
-      if (!peerPackets.second.empty()) info->structValue->insert(StructElement("RORG", std::make_shared<Variable>(peerPackets.second.back()->getRorg())));
-      if (!peerPackets.second.empty()) info->structValue->insert(StructElement("RSSI", std::make_shared<Variable>(peerPackets.second.back()->getRssi())));
+      info->structValue->insert(StructElement("ADDRESS", std::make_shared<Variable>(summary.address)));
+      info->structValue->insert(StructElement("RORG", std::make_shared<Variable>(summary.rorg)));
+      info->structValue->insert(StructElement("RSSI", std::make_shared<Variable>(summary.rssi)));
+      info->structValue->insert(StructElement("COUNT", std::make_shared<Variable>((int64_t)summary.count)));
+      info->structValue->insert(StructElement("FIRST_SEEN", std::make_shared<Variable>(summary.firstSeen / 1000)));
+      info->structValue->insert(StructElement("LAST_SEEN", std::make_shared<Variable>(summary.lastSeen / 1000)));
 
       PVariable packets(new Variable(VariableType::tArray));
       info->structValue->insert(StructElement("PACKETS", packets));
-
-      for (const auto &packet: peerPackets.second) {
+      packets->arrayValue->reserve(summary.recentTelegrams.size());
+      for (const auto &telegram: summary.recentTelegrams) {
         PVariable packetInfo(new Variable(VariableType::tStruct));
-        packetInfo->structValue->insert(StructElement("TIME_RECEIVED", std::make_shared<Variable>(packet->getTimeReceived() / 1000)));
-        packetInfo->structValue->insert(StructElement("PACKET", std::make_shared<Variable>(BaseLib::HelperFunctions::getHexString(packet->getBinary()))));
+        packetInfo->structValue->insert(StructElement("TIME_RECEIVED", std::make_shared<Variable>(telegram.time / 1000)));
+        packetInfo->structValue->insert(StructElement("PACKET", std::make_shared<Variable>(BaseLib::HelperFunctions::getHexString(telegram.packet))));
         packets->arrayValue->push_back(packetInfo);
       }
     }
@@ -2172,9 +2475,11 @@ bool EnOceanCentral::updateFirmware(const std::unordered_set<uint64_t> &ids, boo
     auto updateAddressSettings = Gd::family->getFamilySetting("updateAddress");
     uint32_t updateAddress = updateAddressSettings ? (uint32_t)updateAddressSettings->integerValue : (baseAddress | 1u);
 
-    auto dutyCycleInfo = interface->getDutyCycleInfo();
-    if (dutyCycleInfo.dutyCycleUsed > 10) interface->reset();
-    dutyCycleInfo = interface->getDutyCycleInfo();
+    auto dutyCycleInfo = interface->getDutyCycleInfo(true);
+    if (dutyCycleInfo.dutyCycleUsed > 10) {
+      interface->reset();
+      dutyCycleInfo = interface->getDutyCycleInfo(true);
+    }
     if (dutyCycleInfo.dutyCycleUsed > 10) {
       Gd::out.printError("Error: Not enough duty cycle available.");
       return false;
@@ -2334,12 +2639,16 @@ bool EnOceanCentral::updateFirmware(const std::unordered_set<uint64_t> &ids, boo
           Gd::out.printError("Error: Updates did not finish.");
           return false;
         }
-        dutyCycleInfo = interface->getDutyCycleInfo();
-        if (dutyCycleInfo.dutyCycleUsed > 90) interface->reset();
+        //The local estimate costs no serial round trip. The module is only asked again after a reset.
         dutyCycleInfo = interface->getDutyCycleInfo();
         if (dutyCycleInfo.dutyCycleUsed > 90) {
-          Gd::out.printInfo("Info: Waiting for duty cycle to free up. Waiting " + std::to_string(dutyCycleInfo.timeLeftInSlot) + " seconds.");
-          std::this_thread::sleep_for(std::chrono::milliseconds(5000));
+          interface->reset();
+          dutyCycleInfo = interface->getDutyCycleInfo(true);
+        }
+        if (dutyCycleInfo.dutyCycleUsed > 90) {
+          uint32_t waitingTime = dutyCycleInfo.timeLeftInSlot > 0 && dutyCycleInfo.timeLeftInSlot < 60 ? dutyCycleInfo.timeLeftInSlot : 60;
+          Gd::out.printInfo("Info: Waiting for duty cycle to free up. Waiting " + std::to_string(waitingTime) + " seconds.");
+          std::this_thread::sleep_for(std::chrono::seconds(waitingTime));
         } else break;
       }
 
@@ -2951,14 +3260,25 @@ PVariable EnOceanCentral::setInterface(BaseLib::PRpcClientInfo clientInfo, uint6
 }
 
 PVariable EnOceanCentral::startSniffing(BaseLib::PRpcClientInfo clientInfo) {
-  std::lock_guard<std::mutex> sniffedPacketsGuard(_sniffedPacketsMutex);
-  _sniffedPackets.clear();
-  _sniff = true;
-  return std::make_shared<Variable>();
+  try {
+    auto bufferSizeSetting = Gd::family->getFamilySetting("sniffBufferSize");
+    uint32_t bufferSize = bufferSizeSetting && bufferSizeSetting->integerValue > 0 ? (uint32_t)bufferSizeSetting->integerValue : 10000;
+    if (bufferSize > Sniffer::maxBufferSize) {
+      Gd::out.printWarning("Warning: sniffBufferSize is too large. Using " + std::to_string(Sniffer::maxBufferSize) + ".");
+      bufferSize = Sniffer::maxBufferSize;
+    }
+    auto captureFileSetting = Gd::family->getFamilySetting("sniffCaptureFile");
+    _sniffer.start(bufferSize, captureFileSetting ? captureFileSetting->stringValue : "");
+    return std::make_shared<Variable>();
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Variable::createError(-32500, "Unknown application error.");
 }
 
 PVariable EnOceanCentral::stopSniffing(BaseLib::PRpcClientInfo clientInfo) {
-  _sniff = false;
+  _sniffer.stop();
   return std::make_shared<Variable>();
 }
 
@@ -3083,6 +3403,45 @@ BaseLib::PVariable EnOceanCentral::getMeshingInfo(const PRpcClientInfo &clientIn
   return Variable::createError(-32500, "Unknown application error.");
 }
 
+BaseLib::PVariable EnOceanCentral::getSniffedPackets(const PRpcClientInfo &clientInfo, const PArray &parameters) {
+  try {
+    if (parameters->size() < 2 || parameters->size() > 3) return BaseLib::Variable::createError(-1, "Wrong parameter count.");
+    if (parameters->at(0)->type != BaseLib::VariableType::tInteger && parameters->at(0)->type != BaseLib::VariableType::tInteger64) return BaseLib::Variable::createError(-1, "Parameter 1 is not of type Integer.");
+    if (parameters->at(1)->type != BaseLib::VariableType::tInteger && parameters->at(1)->type != BaseLib::VariableType::tInteger64) return BaseLib::Variable::createError(-1, "Parameter 2 is not of type Integer.");
+    if (parameters->size() == 3 && parameters->at(2)->type != BaseLib::VariableType::tInteger && parameters->at(2)->type != BaseLib::VariableType::tInteger64) return BaseLib::Variable::createError(-1, "Parameter 3 is not of type Integer.");
+
+    uint64_t from = parameters->at(0)->integerValue64 > 0 ? (uint64_t)parameters->at(0)->integerValue64 : 0;
+    int64_t count = parameters->at(1)->integerValue64;
+    if (count <= 0 || count > 1000) count = 1000;
+    int32_t address = parameters->size() == 3 ? parameters->at(2)->integerValue : -1;
+
+    uint64_t nextSequence = 0;
+    auto telegrams = _sniffer.getTelegrams(from, (uint32_t)count, address, nextSequence);
+
+    auto result = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    auto packets = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+    packets->arrayValue->reserve(telegrams.size());
+    for (auto &telegram: telegrams) {
+      auto packetInfo = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      packetInfo->structValue->emplace("SEQUENCE", std::make_shared<BaseLib::Variable>((int64_t)telegram.sequence));
+      //Seconds like in getSniffedDevices()
+      packetInfo->structValue->emplace("TIME_RECEIVED", std::make_shared<BaseLib::Variable>(telegram.time / 1000));
+      packetInfo->structValue->emplace("ADDRESS", std::make_shared<BaseLib::Variable>(telegram.senderAddress));
+      packetInfo->structValue->emplace("INTERFACE", std::make_shared<BaseLib::Variable>(Gd::interfaces->getInterfaceByHandle(telegram.interfaceHandle)->getID()));
+      packetInfo->structValue->emplace("RSSI", std::make_shared<BaseLib::Variable>(telegram.rssi));
+      packetInfo->structValue->emplace("PACKET", std::make_shared<BaseLib::Variable>(BaseLib::HelperFunctions::getHexString(telegram.packet)));
+      packets->arrayValue->push_back(packetInfo);
+    }
+    result->structValue->emplace("PACKETS", packets);
+    result->structValue->emplace("NEXT", std::make_shared<BaseLib::Variable>((int64_t)nextSequence));
+    return result;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Variable::createError(-32500, "Unknown application error.");
+}
+
 BaseLib::PVariable EnOceanCentral::queryFirmwareVersion(const PRpcClientInfo &clientInfo, const PArray &parameters) {
   try {
     if (parameters->empty()) return BaseLib::Variable::createError(-1, "Wrong parameter count.");
@@ -7,11 +7,17 @@
 
 #include "EnOceanPeer.h"
 #include "EnOceanPacket.h"
+#include "LockFreeQueue.h"
+#include "DuplicateFilter.h"
+#include "Sniffer.h"
 #include <homegear-base/BaseLib.h>
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace EnOcean {
 
@@ -83,16 +89,66 @@ class EnOceanCentral : public BaseLib::Systems::ICentral {
     std::vector<uint8_t> aesKeyOutbound;
   };
 
+  struct ReceivedPacket {
+    std::string interfaceId;
+    PEnOceanPacket packet;
+    /**
+     * Set for duplicates with a better RSSI. They are only used to select the best interface.
+     */
+    bool roamingOnly = false;
+  };
+
+  enum class DropPolicy {
+    dropOldest,
+    dropNewest
+  };
+
   std::map<std::string, std::function<BaseLib::PVariable(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters)>> _localRpcMethods;
 
-  bool _sniff = false;
-  std::mutex _sniffedPacketsMutex;
-  std::map<int32_t, std::vector<PEnOceanPacket>> _sniffedPackets;
+  /**
+   * Packets of one device always go to the same shard, so they are processed in order.
+   */
+  struct DispatchShard {
+    explicit DispatchShard(size_t queueSize) : packets(queueSize) {}
+
+    LockFreeQueue<ReceivedPacket> packets;
+    std::atomic<uint32_t> signal{0};
+    std::thread thread;
+    std::atomic<uint64_t> processedPacketCount{0};
+  };
+
+  //{{{ Packet dispatch
+  std::vector<std::unique_ptr<DispatchShard>> _dispatchShards;
+  DropPolicy _dropPolicy = DropPolicy::dropOldest;
+  std::atomic_bool _stopDispatchThreads{false};
+  std::atomic<uint64_t> _queuedPacketCount{0};
+  std::atomic<uint64_t> _droppedPacketCount{0};
+  DuplicateFilter _duplicateFilter;
+  //}}}
+
+  Sniffer _sniffer;
 
   std::map<int32_t, std::list<PMyPeer>> _peers;
   std::mutex _wildcardPeersMutex;
   std::map<int32_t, std::list<PMyPeer>> _wildcardPeers;
 
+  /**
+   * Immutable copy of _peers and _wildcardPeers for the receive path. It is replaced as a whole when peers are added
+   * or deleted, so readers need no lock and no copy.
+   */
+  struct PeerAddressIndex {
+    std::unordered_map<int32_t, std::vector<PMyPeer>> peers;
+    std::unordered_map<int32_t, std::vector<PMyPeer>> wildcardPeers;
+
+    /**
+     * @return The peers with this address or, when there are none, the wildcard peers of the address's /25 range.
+     * nullptr when nothing was found.
+     */
+    const std::vector<PMyPeer> *find(int32_t senderAddress) const;
+  };
+  std::mutex _peerAddressIndexMutex;
+  std::atomic<std::shared_ptr<const PeerAddressIndex>> _peerAddressIndex{std::make_shared<const PeerAddressIndex>()};
+
   PairingInfo _pairingInfo;
   PairingData _pairingData;
 
@@ -106,11 +162,25 @@ class EnOceanCentral : public BaseLib::Systems::ICentral {
   std::thread _updateFirmwareThread;
   std::atomic<int64_t> _firmwareInstallationTime{0};
   std::atomic<int64_t> _lastForeignFirmwareUpdatePacket{0};
+  std::mutex _foreignFirmwareUpdateMutex;
   //}}}
 
   std::string getFreeSerialNumber(int32_t address);
   void init();
   void worker();
+  void dispatchWorker(DispatchShard *shard);
+  uint32_t getDispatchShardIndex(int32_t senderAddress);
+
+  /**
+   * Called by the dispatch workers. With more than one worker it runs concurrently for packets of different senders.
+   * Shared state is protected: Peers are looked up in an immutable snapshot, pairing requests are serialized by
+   * _pairingInfo.pairingMutex and work on a copy of _pairingData, the sniffer has its own locks and foreign firmware
+   * update packets are recorded under _foreignFirmwareUpdateMutex. Roaming only changes the peer of the sender, whose
+   * packets are always processed by the same worker.
+   */
+  bool processPacket(std::string &senderId, PEnOceanPacket &packet);
+  void updatePeerAddressIndex();
+  void updateRoaming(const std::string &senderId, const PEnOceanPacket &packet, const PMyPeer &peer);
   void pingWorker();
   void loadPeers() override;
   void savePeers(bool full) override;
@@ -134,6 +204,7 @@ class EnOceanCentral : public BaseLib::Systems::ICentral {
   BaseLib::PVariable addMeshingEntry(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
   BaseLib::PVariable checkUpdateAddress(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
   BaseLib::PVariable getMeshingInfo(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
+  BaseLib::PVariable getSniffedPackets(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
   BaseLib::PVariable queryFirmwareVersion(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
   BaseLib::PVariable resetMeshingTables(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
   BaseLib::PVariable remanGetLinkTable(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters);
@@ -9,37 +9,69 @@ EnOceanPacket::EnOceanPacket() {
 }
 
 EnOceanPacket::EnOceanPacket(const std::vector<uint8_t> &espPacket) : _packet(espPacket) {
-  if (espPacket.size() < 6) return;
-  uint32_t dataSize = ((uint16_t)espPacket[1] << 8) | espPacket[2];
-  uint32_t optionalSize = espPacket[3];
+  parse();
+}
+
+EnOceanPacket::EnOceanPacket(std::vector<uint8_t> &&espPacket) : _packet(std::move(espPacket)) {
+  parse();
+}
+
+void EnOceanPacket::reset(const std::vector<uint8_t> &espPacket) {
+  _appendAddressAndStatus = false;
+  _packet.assign(espPacket.begin(), espPacket.end());
+  _dataInPacket = false;
+  _dataSize = 0;
+  _optionalDataSize = 0;
+  _senderAddress = 0;
+  _destinationAddress = 0;
+  _type = Type::RESERVED;
+  _rssi = 0;
+  _interfaceHandle = 0;
+  _rorg = 0;
+  _status = 0;
+  _repeatingStatus = RepeatingStatus::kOriginal;
+  _remoteManagementFunction = 0;
+  _remoteManagementManufacturer = 0;
+  _data.clear();
+  _optionalData.clear();
+  parse();
+}
+
+void EnOceanPacket::parse() {
+  if (_packet.size() < 6) return;
+  uint32_t dataSize = ((uint16_t)_packet[1] << 8) | _packet[2];
+  uint32_t optionalSize = _packet[3];
   uint32_t fullSize = dataSize + optionalSize;
-  if (espPacket.size() != fullSize + 7 || fullSize == 0) {
-    Gd::out.printWarning("Warning: Tried to import packet with wrong size information: " + BaseLib::HelperFunctions::getHexString(espPacket));
+  if (_packet.size() != fullSize + 7 || fullSize == 0) {
+    Gd::out.printWarning("Warning: Tried to import packet with wrong size information: " + BaseLib::HelperFunctions::getHexString(_packet));
     return;
   }
   _timeReceived = BaseLib::HelperFunctions::getTime();
-  _type = (Type)espPacket[4];
-  _data.insert(_data.end(), espPacket.begin() + 6, espPacket.begin() + 6 + dataSize);
-  _optionalData.insert(_optionalData.end(), espPacket.begin() + 6 + dataSize, espPacket.begin() + 6 + dataSize + optionalSize);
+  _type = (Type)_packet[4];
+  _dataInPacket = true;
+  _dataSize = dataSize;
+  _optionalDataSize = optionalSize;
+  auto data = getDataView();
+  auto optionalData = getOptionalDataView();
 
   if (_type == Type::RADIO_ERP1 || _type == Type::RADIO_ERP2) {
-    if (!_data.empty()) _rorg = (uint8_t)_data[0];
-    if (_data.size() >= 6) {
-      _senderAddress = (((int32_t)(uint8_t)_data[_data.size() - 5]) << 24) | (((int32_t)(uint8_t)_data[_data.size() - 4]) << 16) | (((int32_t)(uint8_t)_data[_data.size() - 3]) << 8) | ((int32_t)(uint8_t)_data[_data.size() - 2]);
+    if (!data.empty()) _rorg = (uint8_t)data[0];
+    if (data.size() >= 6) {
+      _senderAddress = (((int32_t)(uint8_t)data[data.size() - 5]) << 24) | (((int32_t)(uint8_t)data[data.size() - 4]) << 16) | (((int32_t)(uint8_t)data[data.size() - 3]) << 8) | ((int32_t)(uint8_t)data[data.size() - 2]);
       //Bit 7 tells us which hash function is used (0 for summation based checksum and 1 for CRC)
       //Bit 0 to 3 is the repeating status
-      _status = (uint8_t)_data[_data.size() - 1];
+      _status = (uint8_t)data[data.size() - 1];
       _repeatingStatus = (RepeatingStatus)(_status & 0x0F);
     }
     //Destination address is unset for RADIO_ERP2
-    if (_optionalData.size() >= 5) _destinationAddress = (((int32_t)(uint8_t)_optionalData[1]) << 24) | (((int32_t)(uint8_t)_optionalData[2]) << 16) | (((int32_t)(uint8_t)_optionalData[3]) << 8) | (int32_t)(uint8_t)_optionalData[4];
-    if (_optionalData.size() >= 2) _rssi = _type == Type::RADIO_ERP1 ? -((int32_t)_optionalData[_optionalData.size() - 2]) : -((int32_t)_optionalData.back());
-  } else if (_type == Type::REMOTE_MAN_COMMAND && _data.size() >= 4 && _optionalData.size() >= 10) {
-    _remoteManagementFunction = (uint16_t)((uint16_t)_data[0] << 8u) | _data[1];
-    _remoteManagementManufacturer = (uint16_t)((uint16_t)_data[2] << 8u) | _data[3];
-    _destinationAddress = (((int32_t)(uint8_t)_optionalData[0]) << 24) | (((int32_t)(uint8_t)_optionalData[1]) << 16) | (((int32_t)(uint8_t)_optionalData[2]) << 8) | (int32_t)(uint8_t)_optionalData[3];
-    _senderAddress = (((int32_t)(uint8_t)_optionalData[4]) << 24) | (((int32_t)(uint8_t)_optionalData[5]) << 16) | (((int32_t)(uint8_t)_optionalData[6]) << 8) | (int32_t)(uint8_t)_optionalData[7];
-    _rssi = -((int32_t)_optionalData[8]);
+    if (optionalData.size() >= 5) _destinationAddress = (((int32_t)(uint8_t)optionalData[1]) << 24) | (((int32_t)(uint8_t)optionalData[2]) << 16) | (((int32_t)(uint8_t)optionalData[3]) << 8) | (int32_t)(uint8_t)optionalData[4];
+    if (optionalData.size() >= 2) _rssi = _type == Type::RADIO_ERP1 ? -((int32_t)optionalData[optionalData.size() - 2]) : -((int32_t)optionalData.back());
+  } else if (_type == Type::REMOTE_MAN_COMMAND && data.size() >= 4 && optionalData.size() >= 10) {
+    _remoteManagementFunction = (uint16_t)((uint16_t)data[0] << 8u) | data[1];
+    _remoteManagementManufacturer = (uint16_t)((uint16_t)data[2] << 8u) | data[3];
+    _destinationAddress = (((int32_t)(uint8_t)optionalData[0]) << 24) | (((int32_t)(uint8_t)optionalData[1]) << 16) | (((int32_t)(uint8_t)optionalData[2]) << 8) | (int32_t)(uint8_t)optionalData[3];
+    _senderAddress = (((int32_t)(uint8_t)optionalData[4]) << 24) | (((int32_t)(uint8_t)optionalData[5]) << 16) | (((int32_t)(uint8_t)optionalData[6]) << 8) | (int32_t)(uint8_t)optionalData[7];
+    _rssi = -((int32_t)optionalData[8]);
   }
 }
 
@@ -71,7 +103,37 @@ EnOceanPacket::~EnOceanPacket() {
   _optionalData.clear();
 }
 
+void EnOceanPacket::detachData() {
+  if (!_dataInPacket) return;
+  auto data = getDataView();
+  auto optionalData = getOptionalDataView();
+  _data.assign(data.begin(), data.end());
+  _optionalData.assign(optionalData.begin(), optionalData.end());
+  _dataInPacket = false;
+}
+
+std::vector<uint8_t> EnOceanPacket::getData() {
+  if (_dataInPacket) {
+    auto data = getDataView();
+    return std::vector<uint8_t>(data.begin(), data.end());
+  }
+  return _data;
+}
+
+std::vector<uint8_t> EnOceanPacket::getOptionalData() {
+  if (_dataInPacket) {
+    auto optionalData = getOptionalDataView();
+    return std::vector<uint8_t>(optionalData.begin(), optionalData.end());
+  }
+  return _optionalData;
+}
+
 void EnOceanPacket::setData(const std::vector<uint8_t> &value, uint32_t offset) {
+  if (_dataInPacket) {
+    auto optionalData = getOptionalDataView();
+    _optionalData.assign(optionalData.begin(), optionalData.end());
+    _dataInPacket = false;
+  }
   _packet.clear();
   _data.clear();
   _data.insert(_data.end(), value.begin() + offset, value.end());
@@ -107,9 +169,25 @@ std::vector<uint8_t> EnOceanPacket::getBinary() {
   return {};
 }
 
+std::span<const uint8_t> EnOceanPacket::getBinaryView() {
+  if (_packet.empty()) getBinary();
+  return _packet;
+}
+
 std::vector<uint8_t> EnOceanPacket::getPosition(uint32_t position, uint32_t size) {
   try {
-    return BaseLib::BitReaderWriter::getPosition(_data, position, size);
+    //Works on the view, so received packets don't need to be copied. Bits are counted from the MSB of the first byte, the result is right aligned.
+    auto data = getDataView();
+    std::vector<uint8_t> result((size + 7) / 8, 0);
+    uint32_t dataBitSize = data.size() * 8;
+    for (uint32_t i = 0; i < size; i++) {
+      uint32_t sourceBit = position + i;
+      if (sourceBit >= dataBitSize) break;
+      if (((data[sourceBit / 8] >> (7 - (sourceBit % 8))) & 1u) == 0) continue;
+      uint32_t targetBit = size - 1 - i;
+      result[result.size() - 1 - (targetBit / 8)] |= (uint8_t)(1u << (targetBit % 8));
+    }
+    return result;
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -119,6 +197,7 @@ std::vector<uint8_t> EnOceanPacket::getPosition(uint32_t position, uint32_t size
 
 void EnOceanPacket::setPosition(uint32_t position, uint32_t size, const std::vector<uint8_t> &source) {
   try {
+    detachData();
     BaseLib::BitReaderWriter::setPositionBE(position, size, _data, source);
   }
   catch (const std::exception &ex) {
@@ -128,6 +207,7 @@ void EnOceanPacket::setPosition(uint32_t position, uint32_t size, const std::vec
 
 std::vector<std::shared_ptr<EnOceanPacket>> EnOceanPacket::getChunks(uint8_t sequence_counter) {
   try {
+    detachData();
     std::vector<PEnOceanPacket> packets;
 
     if ((((unsigned)_destinationAddress != 0xFFFFFFFFu && _data.size() <= 8) || ((unsigned)_destinationAddress == 0xFFFFFFFFu && _data.size() <= 12) || _type == Type::REMOTE_MAN_COMMAND) && (_rorg != 0xC5 || _type == Type::REMOTE_MAN_COMMAND)) {
@@ -4,6 +4,7 @@
 #define ENOCEANPACKET_H_
 
 #include <cstdint>
+#include <span>
 
 #include "Security.h"
 
@@ -114,25 +115,45 @@ class EnOceanPacket : public BaseLib::Systems::Packet {
 
   EnOceanPacket();
   explicit EnOceanPacket(const std::vector<uint8_t> &espPacket);
+  explicit EnOceanPacket(std::vector<uint8_t> &&espPacket);
   EnOceanPacket(Type type, uint8_t rorg, int32_t senderAddress, int32_t destinationAddress, const std::vector<uint8_t> &data = std::vector<uint8_t>());
   ~EnOceanPacket() override;
 
+  /**
+   * Reinitializes the packet with a received ESP3 frame. Existing buffers are reused, so this does not allocate when the
+   * packet was used before. Used by EnOceanPacketPool.
+   */
+  void reset(const std::vector<uint8_t> &espPacket);
+
   int32_t senderAddress() { return _senderAddress; }
   int32_t destinationAddress() { return _destinationAddress; }
   Type getType() { return _type; }
   uint8_t getRorg() { return _rorg; }
   void setRorg(uint8_t value) { _rorg = value; }
   int32_t getRssi() { return _rssi; }
+
+  /**
+   * Handle of the interface which received the packet (see Interfaces::getInterfaceHandle()).
+   */
+  uint32_t getInterfaceHandle() const { return _interfaceHandle; }
+  void setInterfaceHandle(uint32_t value) { _interfaceHandle = value; }
   uint8_t getStatus() { return _status; }
   RepeatingStatus getRepeatingStatus() { return _repeatingStatus; }
   uint16_t getRemoteManagementFunction() { return _remoteManagementFunction; }
   uint16_t getRemoteManagementManufacturer() { return _remoteManagementManufacturer; }
-  std::vector<uint8_t> getData() { return _data; }
+  std::vector<uint8_t> getData();
   void setData(const std::vector<uint8_t> &value, uint32_t offset = 0);
-  int32_t getDataSize() { return _data.size(); }
-  std::vector<uint8_t> getOptionalData() { return _optionalData; }
+  int32_t getDataSize() { return _dataInPacket ? _dataSize : _data.size(); }
+  std::vector<uint8_t> getOptionalData();
   std::vector<uint8_t> getBinary();
 
+  /**
+   * Non-allocating accessors. The returned views are valid until the packet is modified or destroyed.
+   */
+  std::span<const uint8_t> getDataView() { return _dataInPacket ? std::span<const uint8_t>(_packet.data() + 6, _dataSize) : std::span<const uint8_t>(_data); }
+  std::span<const uint8_t> getOptionalDataView() { return _dataInPacket ? std::span<const uint8_t>(_packet.data() + 6 + _dataSize, _optionalDataSize) : std::span<const uint8_t>(_optionalData); }
+  std::span<const uint8_t> getBinaryView();
+
   std::vector<uint8_t> getPosition(uint32_t position, uint32_t size);
   void setPosition(uint32_t position, uint32_t size, const std::vector<uint8_t> &source);
 
@@ -140,10 +161,18 @@ class EnOceanPacket : public BaseLib::Systems::Packet {
  protected:
   bool _appendAddressAndStatus = false;
   std::vector<uint8_t> _packet;
+  /**
+   * True for received packets. Data and optional data are not copied out of _packet then, _dataSize and
+   * _optionalDataSize describe where they are located.
+   */
+  bool _dataInPacket = false;
+  uint32_t _dataSize = 0;
+  uint32_t _optionalDataSize = 0;
   int32_t _senderAddress = 0;
   int32_t _destinationAddress = 0;
   Type _type = Type::RESERVED;
   int32_t _rssi = 0;
+  uint32_t _interfaceHandle = 0;
   uint8_t _rorg = 0;
   uint8_t _status = 0;
   RepeatingStatus _repeatingStatus = RepeatingStatus::kOriginal;
@@ -151,6 +180,9 @@ class EnOceanPacket : public BaseLib::Systems::Packet {
   uint16_t _remoteManagementManufacturer = 0;
   std::vector<uint8_t> _data;
   std::vector<uint8_t> _optionalData;
+
+  void parse();
+  void detachData();
 };
 
 typedef std::shared_ptr<EnOceanPacket> PEnOceanPacket;
@@ -0,0 +1,59 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "EnOceanPacketPool.h"
+
+#include "Gd.h"
+
+#include <algorithm>
+
+namespace EnOcean {
+
+EnOceanPacketPool::EnOceanPacketPool(uint32_t size) {
+  setSize(size);
+}
+
+void EnOceanPacketPool::setSize(uint32_t size) {
+  try {
+    if (size == 0) size = 1;
+    std::lock_guard<std::mutex> packetsGuard(_packetsMutex);
+    _packets.resize(size);
+    _packets.shrink_to_fit();
+    if (_nextIndex >= size) _nextIndex = 0;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+uint32_t EnOceanPacketPool::getSize() {
+  std::lock_guard<std::mutex> packetsGuard(_packetsMutex);
+  return _packets.size();
+}
+
+PEnOceanPacket EnOceanPacketPool::get(const std::vector<uint8_t> &espPacket) {
+  try {
+    std::lock_guard<std::mutex> packetsGuard(_packetsMutex);
+    uint32_t search = std::min((uint32_t)_packets.size(), _maxSearch);
+    for (uint32_t i = 0; i < search; i++) {
+      auto &packet = _packets[_nextIndex];
+      _nextIndex = (_nextIndex + 1) % _packets.size();
+      if (!packet) {
+        //Buffers grow to the largest frame seen and keep their capacity when the packet is reused.
+        packet = std::make_shared<EnOceanPacket>(espPacket);
+        return packet;
+      }
+      //Only the pool owns the packet. Nobody else can obtain a new reference, so it is safe to reuse it.
+      if (packet.use_count() != 1) continue;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      packet->reset(espPacket);
+      return packet;
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  _fallbackCount++;
+  return std::make_shared<EnOceanPacket>(espPacket);
+}
+
+}
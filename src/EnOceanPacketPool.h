@@ -0,0 +1,48 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef ENOCEANPACKETPOOL_H_
+#define ENOCEANPACKETPOOL_H_
+
+#include "EnOceanPacket.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace EnOcean {
+
+/**
+ * Recycles received packets and their buffers.
+ *
+ * The pool keeps one reference to each of its packets. A packet is free again as soon as all other references are
+ * gone, so code that stores packets (receive queues, sniffer, responses) just keeps the slot busy. Slots are filled on
+ * first use. When no free slot is found, a new unpooled packet is created and counted as fallback allocation.
+ */
+class EnOceanPacketPool {
+ public:
+  explicit EnOceanPacketPool(uint32_t size = 64);
+
+  /**
+   * Sets the number of slots. Packets in use keep their buffers, the pool just drops its references to them.
+   */
+  void setSize(uint32_t size);
+  uint32_t getSize();
+
+  /**
+   * Number of packets created outside of the pool because all slots were busy.
+   */
+  uint64_t getFallbackCount() const { return _fallbackCount; }
+
+  PEnOceanPacket get(const std::vector<uint8_t> &espPacket);
+ private:
+  //Maximum number of slots checked per call. Keeps the time spent under _packetsMutex short when the pool is exhausted.
+  static constexpr uint32_t _maxSearch = 64;
+
+  std::mutex _packetsMutex;
+  std::vector<PEnOceanPacket> _packets;
+  uint32_t _nextIndex = 0;
+  std::atomic<uint64_t> _fallbackCount{0};
+};
+
+}
+
+#endif
@@ -5,7 +5,9 @@
 #include "Gd.h"
 #include "EnOceanCentral.h"
 #include "EnOceanPackets.h"
+#include "Log.h"
 
+#include <algorithm>
 #include <iomanip>
 
 namespace EnOcean {
@@ -42,6 +44,8 @@ void EnOceanPeer::init() {
   try {
     _lastPing = BaseLib::HelperFunctions::getTimeSeconds() + BaseLib::HelperFunctions::getRandomNumber(0, 60);
     _nextMeshingCheck = BaseLib::HelperFunctions::getTimeSeconds() + BaseLib::HelperFunctions::getRandomNumber(300, 1800);
+    //Holds no key material (see SecurityContext), so there is no reason to create it on first use.
+    _security = std::make_shared<Security>(Gd::bl);
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -50,11 +54,118 @@ void EnOceanPeer::init() {
 
 void EnOceanPeer::dispose() {
   if (_disposing) return;
+  //Values of deleted peers must not be written back.
+  if (deleting) _persistenceQueue.clear();
+  else {
+    _persistenceQueue.flush();
+    releaseRollingCodes();
+  }
   Peer::dispose();
 }
 
+void EnOceanPeer::setRollingCodeInbound(uint32_t value) {
+  if (value != 0xFFFFFFFF) value &= getRollingCodeMask();
+  _rollingCodeInbound = value;
+  reserveRollingCode(29, value, _reservedRollingCodeInbound);
+}
+
+void EnOceanPeer::setRollingCodeOutbound(uint32_t value) {
+  if (value != 0xFFFFFFFF) value &= getRollingCodeMask();
+  _rollingCodeOutbound = value;
+  reserveRollingCode(20, value, _reservedRollingCodeOutbound);
+}
+
+void EnOceanPeer::setAesKeyInbound(const std::vector<uint8_t> &value) {
+  _aesKeyInbound = value;
+  _securityContextInbound.store(createSecurityContext(value));
+  saveVariable(28, _aesKeyInbound);
+  if (!_aesKeyOutbound.empty()) _forceEncryption = true;
+}
+
+void EnOceanPeer::setAesKeyOutbound(const std::vector<uint8_t> &value) {
+  _aesKeyOutbound = value;
+  _securityContextOutbound.store(createSecurityContext(value));
+  saveVariable(21, _aesKeyOutbound);
+  if (!_aesKeyInbound.empty()) _forceEncryption = true;
+}
+
+uint32_t EnOceanPeer::getRollingCodeMask() const {
+  if (_rollingCodeSize == 2) return 0xFFFF;
+  if (_rollingCodeSize == 3) return 0xFFFFFF;
+  return 0xFFFFFFFF;
+}
+
+PSecurityContext EnOceanPeer::createSecurityContext(const std::vector<uint8_t> &aesKey) {
+  if (aesKey.empty()) return PSecurityContext();
+  auto context = std::make_shared<SecurityContext>(aesKey);
+  return context->isValid() ? context : PSecurityContext();
+}
+
+void EnOceanPeer::reserveRollingCode(uint32_t index, uint32_t value, std::atomic<uint32_t> &reservedRollingCode) {
+  try {
+    uint32_t mask = getRollingCodeMask();
+    uint32_t reservation = Gd::settings.rollingCodeReservation();
+    //2 and 3 byte codes wrap around, so does their reservation. 4 byte codes are not reserved close to the end.
+    if (value == 0xFFFFFFFF || reservation == 0 || (mask == 0xFFFFFFFF && value > 0xFFFFFFFE - reservation)) {
+      reservedRollingCode = value;
+      saveVariable(index, (int64_t)value);
+      return;
+    }
+
+    uint32_t reservedValue = reservedRollingCode;
+    //The check for the upper bound catches codes set back, e. g. on teach-in. They need a new reservation, too.
+    uint32_t distance = (reservedValue - value) & mask;
+    if (reservedValue != 0xFFFFFFFF && distance <= reservation && distance > reservation / 2) return;
+    reservedValue = (value + reservation) & mask;
+    reservedRollingCode = reservedValue;
+    saveVariable(index, (int64_t)reservedValue);
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void EnOceanPeer::releaseRollingCodes() {
+  try {
+    if (_peerID == 0) return;
+    //Clean shutdown, so the exact codes are stored and nothing is skipped on the next start.
+    uint32_t rollingCodeOutbound = _rollingCodeOutbound;
+    if (rollingCodeOutbound != _reservedRollingCodeOutbound) {
+      _reservedRollingCodeOutbound = rollingCodeOutbound;
+      saveVariable(20, (int64_t)rollingCodeOutbound);
+    }
+    uint32_t rollingCodeInbound = _rollingCodeInbound;
+    if (rollingCodeInbound != _reservedRollingCodeInbound) {
+      _reservedRollingCodeInbound = rollingCodeInbound;
+      saveVariable(29, (int64_t)rollingCodeInbound);
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void EnOceanPeer::flushPendingWrites() {
+  _persistenceQueue.flush();
+}
+
+void EnOceanPeer::saveParameterDeferred(BaseLib::Systems::RpcConfigurationParameter &parameter, uint32_t channel, const std::string &name, std::vector<uint8_t> &value) {
+  try {
+    if (parameter.databaseId == 0) {
+      saveParameter(0, ParameterGroup::Type::Enum::variables, channel, name, value);
+      return;
+    }
+    auto databaseId = parameter.databaseId;
+    _persistenceQueue.enqueue(PersistenceQueue::parameterKey | databaseId, [this, databaseId, value]() mutable { saveParameter(databaseId, value); }, Gd::settings.persistenceInterval());
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
 void EnOceanPeer::worker() {
   try {
+    _persistenceQueue.flushIfDue(BaseLib::HelperFunctions::getTime(), Gd::settings.persistenceInterval());
     if (!serviceMessages->getUnreach()) serviceMessages->checkUnreach(_rpcDevice->timeout, getLastPacketReceived());
 
     //{{{ Resends
@@ -145,8 +256,7 @@ void EnOceanPeer::updateBlindSpeed() {
         std::vector<uint8_t> parameterData;
         parameterIterator->second.rpcParameter->convertToPacket(blindSpeed, parameterIterator->second.mainRole(), parameterData);
         parameterIterator->second.setBinaryData(parameterData);
-        if (parameterIterator->second.databaseId > 0) saveParameter(parameterIterator->second.databaseId, parameterData);
-        else saveParameter(0, ParameterGroup::Type::Enum::variables, 1, "CURRENT_SPEED", parameterData);
+        saveParameterDeferred(parameterIterator->second, 1, "CURRENT_SPEED", parameterData);
         if (_bl->debugLevel >= 4)
           Gd::out.printInfo("Info: CURRENT_SPEED of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(1) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(parameterData) + ".");
 
@@ -177,8 +287,7 @@ void EnOceanPeer::updateBlindPosition() {
         std::vector<uint8_t> parameterData;
         parameterIterator->second.rpcParameter->convertToPacket(blindPosition, parameterIterator->second.mainRole(), parameterData);
         parameterIterator->second.setBinaryData(parameterData);
-        if (parameterIterator->second.databaseId > 0) saveParameter(parameterIterator->second.databaseId, parameterData);
-        else saveParameter(0, ParameterGroup::Type::Enum::variables, 1, "CURRENT_POSITION", parameterData);
+        saveParameterDeferred(parameterIterator->second, 1, "CURRENT_POSITION", parameterData);
         if (_bl->debugLevel >= 4)
           Gd::out.printInfo("Info: CURRENT_POSITION of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(1) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(parameterData) + ".");
 
@@ -360,19 +469,20 @@ std::string EnOceanPeer::printConfig() {
 }
 
 std::shared_ptr<IEnOceanInterface> EnOceanPeer::getPhysicalInterface() {
-  if (_physicalInterfaceId.empty()) return Gd::interfaces->getDefaultInterface();
-  else return Gd::interfaces->getInterface(_physicalInterfaceId);
+  return Gd::interfaces->getInterfaceByHandle(_physicalInterfaceHandle);
 }
 
 std::string EnOceanPeer::getPhysicalInterfaceId() {
-  if (_physicalInterfaceId.empty()) Gd::interfaces->getDefaultInterface()->getID();
+  if (_physicalInterfaceId.empty()) return Gd::interfaces->getDefaultInterface()->getID();
   return _physicalInterfaceId;
 }
 
 void EnOceanPeer::setPhysicalInterfaceId(std::string id) {
   if (id.empty() || Gd::interfaces->hasInterface(id)) {
     _physicalInterfaceId = id;
-    saveVariable(19, _physicalInterfaceId);
+    _physicalInterfaceHandle = Gd::interfaces->getInterfaceHandle(id);
+    //Changes with roaming, so it is deferred like values.
+    _persistenceQueue.enqueue(19, [this, id]() mutable { saveVariable(19, id); }, Gd::settings.persistenceInterval());
   }
 }
 
@@ -544,9 +654,7 @@ void EnOceanPeer::setBestInterface() {
   try {
     auto physicalInterface = getPhysicalInterface();
     if (physicalInterface->isOpen()) return; //Only change interface, when the current one is unavailable. If it is available it is switched in onPacketReceived of myCentral.
-    std::string settingName = "roaming";
-    auto roamingSetting = Gd::family->getFamilySetting(settingName);
-    if (roamingSetting && !roamingSetting->integerValue) return;
+    if (!Gd::settings.roaming()) return;
     std::shared_ptr<IEnOceanInterface> bestInterface = Gd::interfaces->getDefaultInterface()->isOpen() ? Gd::interfaces->getDefaultInterface() : std::shared_ptr<IEnOceanInterface>();
     auto interfaces = Gd::interfaces->getInterfaces();
     for (auto &interface: interfaces) {
@@ -572,6 +680,8 @@ void EnOceanPeer::loadVariables(BaseLib::Systems::ICentral *central, std::shared
     _rpcDevice = Gd::family->getRpcDevices()->find(_deviceType, _firmwareVersion, -1);
     if (!_rpcDevice) return;
 
+    uint32_t rollingCodeOutbound = 0xFFFFFFFF;
+    uint32_t rollingCodeInbound = 0xFFFFFFFF;
     for (auto &row: *rows) {
       switch (row.second.at(2)->intValue) {
         case 12: {
@@ -580,10 +690,12 @@ void EnOceanPeer::loadVariables(BaseLib::Systems::ICentral *central, std::shared
         }
         case 19: {
           _physicalInterfaceId = row.second.at(4)->textValue;
+          _physicalInterfaceHandle = Gd::interfaces->getInterfaceHandle(_physicalInterfaceId);
           break;
         }
         case 20: {
-          _rollingCodeOutbound = (uint32_t)row.second.at(3)->intValue;
+          //After an unclean shutdown this is the reservation, so codes possibly accepted before are not accepted again.
+          rollingCodeOutbound = (uint32_t)row.second.at(3)->intValue;
           break;
         }
         case 21: {
@@ -621,7 +733,8 @@ void EnOceanPeer::loadVariables(BaseLib::Systems::ICentral *central, std::shared
           break;
         }
         case 29: {
-          setRollingCodeInbound(((uint32_t)row.second.at(3)->intValue) + 1000);
+          //After an unclean shutdown this is the reservation, so no code is sent twice.
+          rollingCodeInbound = (uint32_t)row.second.at(3)->intValue;
           break;
         }
         case 30: {
@@ -655,7 +768,13 @@ void EnOceanPeer::loadVariables(BaseLib::Systems::ICentral *central, std::shared
       }
     }
 
+    //Set after the loop, as the reservation depends on the rolling code size.
+    if (rollingCodeOutbound != 0xFFFFFFFF) setRollingCodeOutbound(rollingCodeOutbound);
+    if (rollingCodeInbound != 0xFFFFFFFF) setRollingCodeInbound(rollingCodeInbound);
+
     if (_aesKeyInbound.empty() && !_aesKeyOutbound.empty()) _aesKeyInbound = _aesKeyOutbound;
+    _securityContextInbound.store(createSecurityContext(_aesKeyInbound));
+    _securityContextOutbound.store(createSecurityContext(_aesKeyOutbound));
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -681,7 +800,7 @@ void EnOceanPeer::saveVariables() {
     Peer::saveVariables();
     savePeers(); //12
     saveVariable(19, _physicalInterfaceId);
-    saveVariable(20, (int32_t)_rollingCodeOutbound);
+    saveVariable(20, (int32_t)(_reservedRollingCodeOutbound != 0xFFFFFFFF ? _reservedRollingCodeOutbound : _rollingCodeOutbound));
     saveVariable(21, _aesKeyOutbound);
     saveVariable(22, _encryptionType);
     saveVariable(23, _cmacSize);
@@ -690,7 +809,7 @@ void EnOceanPeer::saveVariables() {
     saveVariable(26, (int32_t)_gatewayAddress);
     saveUpdatedParameters(); //27
     saveVariable(28, _aesKeyInbound);
-    saveVariable(29, (int64_t)_rollingCodeInbound);
+    saveVariable(29, (int64_t)(_reservedRollingCodeInbound != 0xFFFFFFFF ? _reservedRollingCodeInbound : _rollingCodeInbound));
     saveVariable(30, (int64_t)_securityCode);
     saveVariable(32, (int64_t)_repeaterId);
 
@@ -1128,85 +1247,76 @@ PRemanFeatures EnOceanPeer::getRemanFeatures() {
 void EnOceanPeer::getValuesFromPacket(PEnOceanPacket packet, std::vector<FrameValues> &frameValues) {
   try {
     if (!_rpcDevice) return;
-    //equal_range returns all elements with "0" or an unknown element as argument
-    if (_rpcDevice->packetsByMessageType.find(packet->getRorg()) == _rpcDevice->packetsByMessageType.end()) return;
-    std::pair<PacketsByMessageType::iterator, PacketsByMessageType::iterator> range = _rpcDevice->packetsByMessageType.equal_range((uint32_t)packet->getRorg());
-    if (range.first == _rpcDevice->packetsByMessageType.end()) return;
-    auto i = range.first;
-    do {
-      FrameValues currentFrameValues;
-      PPacket frame(i->second);
-      if (!frame) continue;
-      std::vector<uint8_t> erpPacket = packet->getData();
-      if (erpPacket.empty()) break;
-      uint32_t erpPacketBitSize = erpPacket.size() * 8;
-      int32_t channelIndex = frame->channelIndex;
+    auto decodePlan = _decodePlan.load();
+    if (!decodePlan || !decodePlan->isFor(_rpcDevice)) {
+      decodePlan = DecodePlan::get(_rpcDevice);
+      if (!decodePlan) return;
+      _decodePlan.store(decodePlan);
+    }
+    auto erpPacket = packet->getDataView();
+    if (erpPacket.empty()) return;
+    uint32_t erpPacketBitSize = erpPacket.size() * 8;
+    //Only frames whose constant fields match are decoded.
+    decodePlan->forEachMatchingFrame(packet->getRorg(), erpPacket, [&](const DecodePlan::Frame &frame) {
       int32_t channel = -1;
-      if (channelIndex >= 0 && channelIndex < (signed)erpPacket.size()) channel = erpPacket.at(channelIndex);
-      if (channel > -1 && frame->channelSize < 8.0) channel &= (0xFFu >> (unsigned)(8u - std::lround(frame->channelSize)));
-      channel += frame->channelIndexOffset;
-      if (frame->channel > -1) channel = frame->channel;
-      if (channel == -1) continue;
-      currentFrameValues.frameID = frame->id;
-      bool abort = false;
-
-      for (auto j = frame->binaryPayloads.begin(); j != frame->binaryPayloads.end(); ++j) {
-        std::vector<uint8_t> data;
-        if ((*j)->bitSize > 0 && (*j)->bitIndex > 0) {
-          if ((*j)->bitIndex >= erpPacketBitSize) continue;
-          data = packet->getPosition((*j)->bitIndex, (*j)->bitSize);
-
-          if ((*j)->constValueInteger > -1) {
-            int32_t intValue = 0;
-            BaseLib::HelperFunctions::memcpyBigEndian(intValue, data);
-            if (intValue != (*j)->constValueInteger) {
-              abort = true;
-              break;
-            } else if ((*j)->parameterId.empty()) continue;
+      if (frame.channelIndex >= 0 && frame.channelIndex < (signed)erpPacket.size()) channel = erpPacket[frame.channelIndex] & frame.channelMask;
+      channel += frame.channelIndexOffset;
+      if (frame.fixedChannel > -1) channel = frame.fixedChannel;
+      if (channel == -1) return;
+
+      //Only the first variable with channels determines the channels of the frame, the following variables are
+      //restricted to them. For "*" these are all channels of the first variable.
+      int32_t startChannel = (channel < 0) ? 0 : channel;
+      FrameValues currentFrameValues;
+
+      for (auto &field : frame.fields) {
+        uint32_t value = 0;
+        std::vector<uint8_t> longValue;
+        if (field.inPacket) {
+          if (field.bitIndex >= erpPacketBitSize || field.discriminatorOnly) continue;
+          if (field.bitSize <= 32) value = DecodePlan::getBits(erpPacket, field.bitIndex, field.bitSize);
+          else {
+            longValue = packet->getPosition(field.bitIndex, field.bitSize);
+            if (field.constValue > -1) {
+              int32_t intValue = 0;
+              BaseLib::HelperFunctions::memcpyBigEndian(intValue, longValue);
+              if (intValue != field.constValue) return;
+            }
           }
-        } else if ((*j)->constValueInteger > -1) {
-          BaseLib::HelperFunctions::memcpyBigEndian(data, (*j)->constValueInteger);
-        } else continue;
-
-        for (auto k = frame->associatedVariables.begin(); k != frame->associatedVariables.end(); ++k) {
-          if ((*k)->physical->groupId != (*j)->parameterId) continue;
-          currentFrameValues.parameterSetType = (*k)->parent()->type();
-          bool setValues = false;
-          if (currentFrameValues.paramsetChannels.empty()) //Fill paramsetChannels
-          {
-            int32_t startChannel = (channel < 0) ? 0 : channel;
-            int32_t endChannel;
-            //When fixedChannel is -2 (means '*') cycle through all channels
-            if (frame->channel == -2) {
-              startChannel = 0;
-              endChannel = _rpcDevice->functions.rbegin()->first;
-            } else endChannel = startChannel;
-            for (int32_t l = startChannel; l <= endChannel; l++) {
-              auto functionIterator = _rpcDevice->functions.find(l);
-              if (functionIterator == _rpcDevice->functions.end()) continue;
-              PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-              if (!parameterGroup || parameterGroup->parameters.find((*k)->id) == parameterGroup->parameters.end()) continue;
-              currentFrameValues.paramsetChannels.push_back(l);
-              currentFrameValues.values[(*k)->id].channels.push_back(l);
-              setValues = true;
+        }
+
+        for (auto &target : field.targets) {
+          currentFrameValues.parameterSetType = target.parameterSetType;
+          FrameValue *frameValue = nullptr;
+          if (currentFrameValues.paramsetChannels.empty()) {
+            if (frame.fixedChannel == -2) {
+              for (auto validChannel : target.validChannels) {
+                if (!frameValue) frameValue = &currentFrameValues.values[target.parameterId];
+                currentFrameValues.paramsetChannels.push_back(validChannel);
+                frameValue->channels.push_back(validChannel);
+              }
+            } else if (target.isValidChannel(startChannel)) {
+              frameValue = &currentFrameValues.values[target.parameterId];
+              currentFrameValues.paramsetChannels.push_back(startChannel);
+              frameValue->channels.push_back(startChannel);
             }
-          } else //Use paramsetChannels
-          {
-            for (std::list<uint32_t>::const_iterator l = currentFrameValues.paramsetChannels.begin(); l != currentFrameValues.paramsetChannels.end(); ++l) {
-              auto functionIterator = _rpcDevice->functions.find(*l);
-              if (functionIterator == _rpcDevice->functions.end()) continue;
-              PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-              if (!parameterGroup || parameterGroup->parameters.find((*k)->id) == parameterGroup->parameters.end()) continue;
-              currentFrameValues.values[(*k)->id].channels.push_back(*l);
-              setValues = true;
+          } else {
+            for (auto paramsetChannel : currentFrameValues.paramsetChannels) {
+              if (!target.isValidChannel(paramsetChannel)) continue;
+              if (!frameValue) frameValue = &currentFrameValues.values[target.parameterId];
+              frameValue->channels.push_back(paramsetChannel);
             }
           }
-          if (setValues) currentFrameValues.values[(*k)->id].value = data;
+          if (!frameValue) continue;
+          if (!field.inPacket) frameValue->value = field.constData;
+          else if (field.bitSize > 32) frameValue->value = longValue;
+          else frameValue->value = DecodePlan::toBinary(value, field.bitSize);
         }
       }
-      if (abort) continue;
-      if (!currentFrameValues.values.empty()) frameValues.push_back(currentFrameValues);
-    } while (++i != range.second && i != _rpcDevice->packetsByMessageType.end());
+      if (currentFrameValues.values.empty()) return;
+      currentFrameValues.frameID = frame.id;
+      frameValues.push_back(std::move(currentFrameValues));
+    });
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -1226,8 +1336,7 @@ void EnOceanPeer::updateValue(const PRpcRequest &request) {
     if (!parameter.rpcParameter) return;
 
     parameter.setBinaryData(request->parameterData);
-    if (parameter.databaseId > 0) saveParameter(parameter.databaseId, request->parameterData);
-    else saveParameter(0, ParameterGroup::Type::Enum::variables, request->channel, request->parameterId, request->parameterData);
+    saveParameterDeferred(parameter, request->channel, request->parameterId, request->parameterData);
     if (_bl->debugLevel >= 4)
       Gd::out.printInfo(
           "Info: " + request->parameterId + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(request->channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(request->parameterData)
@@ -1259,7 +1368,13 @@ void EnOceanPeer::packetReceived(PEnOceanPacket &packet) {
     std::shared_ptr<EnOceanCentral> central = std::dynamic_pointer_cast<EnOceanCentral>(getCentral());
     if (!central) return;
     setLastPacketReceived();
-    if (_lastPacket && BaseLib::HelperFunctions::getTime() - _lastPacket->getTimeReceived() < 1000 && _lastPacket->getBinary() == packet->getBinary()) return;
+    {
+      auto binary = packet->getBinaryView();
+      std::lock_guard<std::mutex> lastPacketGuard(_lastPacketMutex);
+      if (BaseLib::HelperFunctions::getTime() - _lastPacketTime < 1000 && std::equal(_lastPacketBinary.begin(), _lastPacketBinary.end(), binary.begin(), binary.end())) return;
+      _lastPacketBinary.assign(binary.begin(), binary.end());
+      _lastPacketTime = packet->getTimeReceived();
+    }
     setRssiDevice(packet->getRssi() * -1);
     if (_repeaterId == 0) _rssi = packet->getRssi();
     serviceMessages->endUnreach();
@@ -1334,24 +1449,30 @@ void EnOceanPeer::packetReceived(PEnOceanPacket &packet) {
         Gd::out.printError("Error: Encrypted packet received, but Homegear never received the encryption teach-in packets. Please activate \"encryption teach-in\" on your device.");
         return;
       }
-      // Create object here (and not earlier) to avoid unnecessary allocation of secure memory
-      if (!_security) _security.reset(new Security(Gd::bl));
+      auto securityContext = _securityContextOutbound.load();
+      if (!securityContext) {
+        Gd::out.printError("Error: Encrypted packet received, but the AES key of the device is invalid.");
+        return;
+      }
       std::vector<uint8_t> data = packet->getData();
       uint32_t rollingCode = _rollingCodeOutbound;
-      if (_security->checkCmacImplicitRlc(_aesKeyOutbound, data, packet->getDataSize() - _cmacSize - 5, rollingCode, _rollingCodeSize, _cmacSize)) {
+      if (_security->checkCmacImplicitRlc(*securityContext, data, packet->getDataSize() - _cmacSize - 5, rollingCode, _rollingCodeSize, _cmacSize)) {
         if (_bl->debugLevel >= 5) Gd::out.printDebug("Debug: CMAC verified.");
-        if (!_security->decrypt(_aesKeyOutbound, data, packet->getDataSize() - _cmacSize - 5, _rollingCodeOutbound, _rollingCodeSize)) {
+        if (!_security->decrypt(*securityContext, data, packet->getDataSize() - _cmacSize - 5, _rollingCodeOutbound, _rollingCodeSize)) {
           Gd::out.printError("Error: Decryption of packet failed.");
           return;
         }
         packet->setData(data);
         setRollingCodeOutbound(rollingCode + 1);
 
-        Gd::out.printInfo("Decrypted packet: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
+        Log::info(Gd::out, [&]() { return "Decrypted packet: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
 
-        if (!_forceEncryption)
-          Gd::out.printWarning("Warning: Encrypted packet received from peer " + std::to_string(_peerID)
-                                   + " but unencrypted packet will still be accepted. Please set the configuration parameter \"ENCRYPTION\" to \"true\" to enforce encryption and ignore unencrypted packets.");
+        if (!_forceEncryption) {
+          Log::repeatedWarning(Gd::out, Log::RepeatedMessage::unencryptedAcceptedImplicitRlc, _peerID, [&]() {
+            return "Warning: Encrypted packet received from peer " + std::to_string(_peerID)
+                + " but unencrypted packet will still be accepted. Please set the configuration parameter \"ENCRYPTION\" to \"true\" to enforce encryption and ignore unencrypted packets.";
+          });
+        }
       } else {
         Gd::out.printError("Error: Secure packet verification failed. If your device is still working, this might be an attack. If your device is not working please send an encryption teach-in packet to Homegear to resync the encryption.");
         return;
@@ -1480,8 +1601,7 @@ void EnOceanPeer::packetReceived(PEnOceanPacket &packet) {
           //}}}
 
           parameter.setBinaryData(i->second.value);
-          if (parameter.databaseId > 0) saveParameter(parameter.databaseId, i->second.value);
-          else saveParameter(0, ParameterGroup::Type::Enum::variables, *j, i->first, i->second.value);
+          saveParameterDeferred(parameter, *j, i->first, i->second.value);
           if (_bl->debugLevel >= 4)
             Gd::out.printInfo(
                 "Info: " + i->first + " on channel " + std::to_string(*j) + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + " was set to 0x" + BaseLib::HelperFunctions::getHexString(i->second.value)
@@ -2669,24 +2789,29 @@ bool EnOceanPeer::decryptPacket(PEnOceanPacket &packet) {
       Gd::out.printError("Error: Encrypted packet received, but encryption is not configured for device.");
       return false;
     }
-    // Create object here (and not earlier) to avoid unnecessary allocation of secure memory
-    if (!_security) _security.reset(new Security(Gd::bl));
+    auto securityContext = _securityContextOutbound.load();
+    if (!securityContext) {
+      Gd::out.printError("Error: Encrypted packet received, but the AES key of the device is invalid.");
+      return false;
+    }
     std::vector<uint8_t> data = packet->getData();
     uint32_t newRollingCode = 0;
-    if (_security->checkCmacExplicitRlc(_aesKeyOutbound, data, _rollingCodeOutbound, newRollingCode, packet->getDataSize() - _rollingCodeSize - _cmacSize - 5, _rollingCodeSize, _cmacSize)) {
-      _rollingCodeOutbound = newRollingCode;
+    if (_security->checkCmacExplicitRlc(*securityContext, data, _rollingCodeOutbound, newRollingCode, packet->getDataSize() - _rollingCodeSize - _cmacSize - 5, _rollingCodeSize, _cmacSize)) {
+      setRollingCodeOutbound(newRollingCode);
       if (_bl->debugLevel >= 5) Gd::out.printDebug("Debug: CMAC verified.");
-      if (!_security->decrypt(_aesKeyOutbound, data, packet->getDataSize() - _rollingCodeSize - _cmacSize - 5, _rollingCodeOutbound, _rollingCodeSize)) {
+      if (!_security->decrypt(*securityContext, data, packet->getDataSize() - _rollingCodeSize - _cmacSize - 5, _rollingCodeOutbound, _rollingCodeSize)) {
         Gd::out.printError("Error: Decryption of packet failed.");
         return false;
       }
       packet->setData(data, 1);
       if (data.size() >= 2) packet->setRorg(data.at(1)); //Replace RORG with encapsulated one
 
-      Gd::out.printInfo("Decrypted packet: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
+      Log::info(Gd::out, [&]() { return "Decrypted packet: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
 
       if (!_forceEncryption) {
-        Gd::out.printWarning("Warning: Encrypted packet received from peer " + std::to_string(_peerID) + " but unencrypted packet will still be accepted. Please configure peer to ignore unencrypted packets.");
+        Log::repeatedWarning(Gd::out, Log::RepeatedMessage::unencryptedAcceptedExplicitRlc, _peerID, [&]() {
+          return "Warning: Encrypted packet received from peer " + std::to_string(_peerID) + " but unencrypted packet will still be accepted. Please configure peer to ignore unencrypted packets.";
+        });
         return false;
       }
       return true;
@@ -2704,8 +2829,11 @@ std::vector<PEnOceanPacket> EnOceanPeer::encryptPacket(PEnOceanPacket &packet) {
   try {
     if (!_forceEncryption) return packet->getChunks(1);
 
-    // Create object here (and not earlier) to avoid unnecessary allocation of secure memory
-    if (!_security) _security.reset(new Security(Gd::bl));
+    auto securityContext = _securityContextInbound.load();
+    if (!securityContext) {
+      Gd::out.printError("Error: Encryption of packet failed, because the AES key of the device is invalid.");
+      return {};
+    }
 
     auto packets = packet->getChunks(1);
     std::vector<PEnOceanPacket> encrypted_packets;
@@ -2715,9 +2843,9 @@ std::vector<PEnOceanPacket> EnOceanPeer::encryptPacket(PEnOceanPacket &packet) {
       uint32_t rollingCode = _rollingCodeInbound;
       setRollingCodeInbound(_rollingCodeInbound + 1);
 
-      Gd::out.printInfo("Decrypted packet: " + BaseLib::HelperFunctions::getHexString(encrypted_packet->getBinary()));
+      Log::info(Gd::out, [&]() { return "Encrypting packet: " + BaseLib::HelperFunctions::getHexString(encrypted_packet->getBinary()); });
       auto data = encrypted_packet->getData();
-      if (!_security->encryptExplicitRlc(_aesKeyInbound, data, data.size(), rollingCode, _rollingCodeSize, _cmacSize)) {
+      if (!_security->encryptExplicitRlc(*securityContext, data, data.size(), rollingCode, _rollingCodeSize, _cmacSize)) {
         Gd::out.printError("Error: Encryption of packet failed.");
         return {};
       }
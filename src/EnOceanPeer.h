@@ -7,6 +7,8 @@
 
 #include "PhysicalInterfaces/IEnOceanInterface.h"
 #include "EnOceanPacket.h"
+#include "DecodePlan.h"
+#include "PersistenceQueue.h"
 #include "RemanFeatures.h"
 #include <homegear-base/BaseLib.h>
 
@@ -39,27 +41,16 @@ class EnOceanPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserv
 
   //{{{ In table variables
   std::string getPhysicalInterfaceId();
+  uint32_t getPhysicalInterfaceHandle() const { return _physicalInterfaceHandle; }
   void setPhysicalInterfaceId(std::string);
   uint32_t getGatewayAddress();
   void setGatewayAddress(uint32_t value);
-  void setRollingCodeInbound(uint32_t value) {
-    _rollingCodeInbound = value;
-    saveVariable(29, (int64_t)value);
-  }
-  void setRollingCodeOutbound(uint32_t value) {
-    _rollingCodeOutbound = value;
-    saveVariable(20, (int64_t)value);
-  }
-  void setAesKeyInbound(const std::vector<uint8_t> &value) {
-    _aesKeyInbound = value;
-    saveVariable(28, _aesKeyInbound);
-    if (!_aesKeyOutbound.empty()) _forceEncryption = true;
-  }
-  void setAesKeyOutbound(const std::vector<uint8_t> &value) {
-    _aesKeyOutbound = value;
-    saveVariable(21, _aesKeyOutbound);
-    if (!_aesKeyInbound.empty()) _forceEncryption = true;
-  }
+  //Rolling codes are security related and never deferred (see PersistenceQueue). Instead of every code a reserved
+  //high-water mark is stored (see reserveRollingCode()).
+  void setRollingCodeInbound(uint32_t value);
+  void setRollingCodeOutbound(uint32_t value);
+  void setAesKeyInbound(const std::vector<uint8_t> &value);
+  void setAesKeyOutbound(const std::vector<uint8_t> &value);
   void setSecurityCode(uint32_t value) {
     _securityCode = value;
     saveVariable(30, (int64_t)value);
@@ -102,6 +93,11 @@ class EnOceanPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserv
   PRemanFeatures getRemanFeatures();
 
   void worker();
+
+  /**
+   * Writes all deferred database writes, e. g. before shutdown.
+   */
+  void flushPendingWrites();
   void pingWorker();
   std::string handleCliCommand(std::string command) override;
   void packetReceived(PEnOceanPacket &packet);
@@ -222,8 +218,12 @@ class EnOceanPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserv
 
   //In table variables:
   std::string _physicalInterfaceId;
+  std::atomic<uint32_t> _physicalInterfaceHandle{0};
   std::atomic<uint32_t> _rollingCodeOutbound{0xFFFFFFFF};
   std::atomic<uint32_t> _rollingCodeInbound{0xFFFFFFFF};
+  //The rolling codes stored in the database. 0xFFFFFFFF when nothing was reserved yet.
+  std::atomic<uint32_t> _reservedRollingCodeOutbound{0xFFFFFFFF};
+  std::atomic<uint32_t> _reservedRollingCodeInbound{0xFFFFFFFF};
   std::vector<uint8_t> _aesKeyInbound;
   std::vector<uint8_t> _aesKeyOutbound;
   uint32_t _securityCode = 0xFFFFFFFF;
@@ -243,14 +243,23 @@ class EnOceanPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserv
   std::mutex _rfChannelsMutex;
   std::unordered_map<int32_t, int32_t> _rfChannels;
   PRemanFeatures _remanFeatures;
+  std::atomic<std::shared_ptr<const DecodePlan>> _decodePlan;
+  PersistenceQueue _persistenceQueue;
 
   std::mutex _sendPacketMutex;
-  PEnOceanPacket _lastPacket;
+  //Binary and receive time of the last packet for ignoring repetitions. The packet itself is not kept, as that would keep
+  //its slot in the packet pool busy.
+  std::mutex _lastPacketMutex;
+  std::vector<uint8_t> _lastPacketBinary;
+  int64_t _lastPacketTime = 0;
   std::atomic<int32_t> _rssi = 0;
   std::atomic<int32_t> _rssiRepeater = 0;
 
   bool _forceEncryption = false;
   PSecurity _security;
+  //The expanded _aesKeyInbound and _aesKeyOutbound. Replaced whenever the keys change. Empty when there is no key.
+  std::atomic<PSecurityContext> _securityContextInbound;
+  std::atomic<PSecurityContext> _securityContextOutbound;
   std::vector<uint8_t> _aesKeyPart1;
 
   // {{{ Variables for getting RPC responses to requests
@@ -288,6 +297,35 @@ class EnOceanPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserv
 
   void loadVariables(BaseLib::Systems::ICentral *central, std::shared_ptr<BaseLib::Database::DataTable> &rows) override;
   void saveVariables() override;
+
+  /**
+   * Stores a rolling code reservation. Codes up to the reserved code can be used without writing to the database. A new
+   * reservation is stored while half of the current one is left, so it is in the database before the old one is used
+   * up. After an unclean restart the peer continues with the reserved code, i. e. it skips at most
+   * "rollingCodeReservation" codes, which keeps it within the rolling code window of the device. On a clean shutdown
+   * the exact codes are stored (see releaseRollingCodes()). 2 and 3 byte codes and their reservations wrap around.
+   *
+   * @param index The variable index of the rolling code.
+   * @param reservedRollingCode The stored reservation. It is updated when a new one is stored.
+   */
+  void reserveRollingCode(uint32_t index, uint32_t value, std::atomic<uint32_t> &reservedRollingCode);
+  void releaseRollingCodes();
+
+  /**
+   * @return The largest rolling code of the configured rolling code size.
+   */
+  uint32_t getRollingCodeMask() const;
+
+  /**
+   * @return The context for "aesKey" or nullptr when the key is empty or invalid.
+   */
+  static PSecurityContext createSecurityContext(const std::vector<uint8_t> &aesKey);
+
+  /**
+   * Saves the value of a variable through the write-behind queue. Variables not in the database yet are inserted right
+   * away.
+   */
+  void saveParameterDeferred(BaseLib::Systems::RpcConfigurationParameter &parameter, uint32_t channel, const std::string &name, std::vector<uint8_t> &value);
   void loadUpdatedParameters(const std::vector<char> &encodedData);
   void saveUpdatedParameters();
 
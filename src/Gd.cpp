@@ -6,5 +6,6 @@ namespace EnOcean {
 BaseLib::SharedObjects *Gd::bl = nullptr;
 EnOcean *Gd::family = nullptr;
 std::shared_ptr<Interfaces> Gd::interfaces;
+SettingsCache Gd::settings;
 BaseLib::Output Gd::out;
 }
@@ -9,6 +9,7 @@
 #include <homegear-base/BaseLib.h>
 #include "EnOcean.h"
 #include "Interfaces.h"
+#include "SettingsCache.h"
 
 namespace EnOcean {
 
@@ -19,6 +20,7 @@ class Gd {
   static BaseLib::SharedObjects *bl;
   static EnOcean *family;
   static std::shared_ptr<Interfaces> interfaces;
+  static SettingsCache settings;
   static BaseLib::Output out;
  private:
   Gd();
@@ -15,6 +15,7 @@ Interfaces::Interfaces(BaseLib::SharedObjects *bl, std::map<std::string, Systems
 Interfaces::~Interfaces() {
   stopListening();
 
+  _interfacesByHandle.store(std::shared_ptr<const std::vector<std::shared_ptr<IEnOceanInterface>>>());
   _physicalInterfaces.clear();
   _defaultPhysicalInterface.reset();
   _physicalInterfaceEventhandlers.clear();
@@ -69,6 +70,46 @@ void Interfaces::create() {
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
+  updateInterfaceHandles();
+}
+
+void Interfaces::updateInterfaceHandles() {
+  try {
+    std::lock_guard<std::mutex> interfacesGuard(_physicalInterfacesMutex);
+    std::lock_guard<std::mutex> handlesGuard(_interfaceHandlesMutex);
+    for (auto &interfaceBase : _physicalInterfaces) {
+      if (_interfaceHandles.find(interfaceBase.first) == _interfaceHandles.end()) _interfaceHandles.emplace(interfaceBase.first, _interfaceHandles.size() + 1);
+    }
+
+    auto interfacesByHandle = std::make_shared<std::vector<std::shared_ptr<IEnOceanInterface>>>(_interfaceHandles.size() + 1);
+    interfacesByHandle->at(0) = _defaultPhysicalInterface;
+    for (auto &interfaceBase : _physicalInterfaces) {
+      auto interface = std::dynamic_pointer_cast<IEnOceanInterface>(interfaceBase.second);
+      if (!interface) continue;
+      uint32_t handle = _interfaceHandles.at(interfaceBase.first);
+      interface->setHandle(handle);
+      interface->setPacketPoolSize(_packetPoolSize);
+      interfacesByHandle->at(handle) = interface;
+    }
+    _interfacesByHandle.store(std::move(interfacesByHandle));
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void Interfaces::setPacketPoolSize(uint32_t size) {
+  try {
+    _packetPoolSize = size;
+    std::lock_guard<std::mutex> interfacesGuard(_physicalInterfacesMutex);
+    for (auto &interfaceBase : _physicalInterfaces) {
+      auto interface = std::dynamic_pointer_cast<IEnOceanInterface>(interfaceBase.second);
+      if (interface) interface->setPacketPoolSize(size);
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
 }
 
 void Interfaces::startListening() {
@@ -141,6 +182,21 @@ std::shared_ptr<IEnOceanInterface> Interfaces::getInterface(const std::string &n
   return interface;
 }
 
+uint32_t Interfaces::getInterfaceHandle(const std::string &name) {
+  if (name.empty()) return 0;
+  std::lock_guard<std::mutex> handlesGuard(_interfaceHandlesMutex);
+  //IDs of interfaces which don't exist (yet) get a handle, too. It resolves to the default interface until an
+  //interface with this ID is created.
+  return _interfaceHandles.emplace(name, _interfaceHandles.size() + 1).first->second;
+}
+
+std::shared_ptr<IEnOceanInterface> Interfaces::getInterfaceByHandle(uint32_t handle) {
+  auto interfacesByHandle = _interfacesByHandle.load(std::memory_order_acquire);
+  if (!interfacesByHandle || interfacesByHandle->empty()) return getDefaultInterface();
+  if (handle < interfacesByHandle->size() && interfacesByHandle->at(handle)) return interfacesByHandle->at(handle);
+  return interfacesByHandle->front();
+}
+
 void Interfaces::hgdcReconnected() {
   try {
     int32_t cycles = BaseLib::HelperFunctions::getRandomNumber(40, 100);
@@ -190,6 +246,7 @@ void Interfaces::createHgdcInterfaces(bool reconnected) {
         }
       }
     }
+    updateInterfaceHandles();
   }
   catch (const std::exception &ex) {
     Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -273,9 +330,11 @@ void Interfaces::hgdcModuleUpdateThread() {
           settings->serialNumber = settings->id;
           device = std::make_shared<Hgdc>(settings, std::to_string(module.second->structValue->at("firmwareVersion")->integerValue));
 
+          interfaceGuard.lock();
           if (_physicalInterfaces.find(settings->id) != _physicalInterfaces.end()) Gd::out.printError("Error: id used for two devices: " + settings->id);
           _physicalInterfaces[settings->id] = device;
           if (settings->isDefault || !_defaultPhysicalInterface || _defaultPhysicalInterface->getID().empty()) _defaultPhysicalInterface = device;
+          interfaceGuard.unlock();
 
           addedModules->push_back(device);
         } else {
@@ -288,6 +347,8 @@ void Interfaces::hgdcModuleUpdateThread() {
       }
     }
 
+    if (!addedModules->empty()) updateInterfaceHandles();
+
     for (auto &module : *addedModules) {
       if (_central) {
         if (_physicalInterfaceEventhandlers.find(module->getID()) != _physicalInterfaceEventhandlers.end()) continue;
@@ -26,6 +26,22 @@ class Interfaces : public BaseLib::Systems::PhysicalInterfaces {
   bool hasInterface(const std::string &name);
   std::shared_ptr<IEnOceanInterface> getInterface(const std::string &name);
   std::vector<std::shared_ptr<IEnOceanInterface>> getInterfaces();
+
+  /**
+   * Returns the handle interned for an interface ID. Handles are small integers which never change while the module
+   * is loaded. Handle 0 stands for the default interface.
+   */
+  uint32_t getInterfaceHandle(const std::string &name);
+
+  /**
+   * Lock-free lookup for the receive path. Unknown handles and handle 0 return the default interface.
+   */
+  std::shared_ptr<IEnOceanInterface> getInterfaceByHandle(uint32_t handle);
+
+  /**
+   * Sets the number of pooled receive packets of all current and future interfaces.
+   */
+  void setPacketPoolSize(uint32_t size);
   void worker();
  protected:
   BaseLib::PVariable _updatedHgdcModules;
@@ -38,7 +54,14 @@ class Interfaces : public BaseLib::Systems::PhysicalInterfaces {
   std::shared_ptr<IEnOceanInterface> _defaultPhysicalInterface;
   std::map<std::string, PEventHandler> _physicalInterfaceEventhandlers;
 
+  std::mutex _interfaceHandlesMutex;
+  std::unordered_map<std::string, uint32_t> _interfaceHandles;
+  //Index is the handle, index 0 is the default interface. Replaced as a whole when interfaces are added.
+  std::atomic<std::shared_ptr<const std::vector<std::shared_ptr<IEnOceanInterface>>>> _interfacesByHandle;
+  std::atomic<uint32_t> _packetPoolSize{64};
+
   void create() override;
+  void updateInterfaceHandles();
   void hgdcReconnected();
   void createHgdcInterfaces(bool reconnected);
   void hgdcModuleUpdate(const BaseLib::PVariable &modules);
@@ -0,0 +1,103 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef LOCKFREEQUEUE_H_
+#define LOCKFREEQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace EnOcean {
+
+/**
+ * Bounded lock-free queue (Dmitry Vyukov's array based algorithm).
+ *
+ * Any number of threads may push. Pop is safe from multiple threads, too, which is used by producers to drop the
+ * oldest element when the queue is full.
+ */
+template<typename T>
+class LockFreeQueue {
+ public:
+  /**
+   * @param capacity Rounded up to a power of two.
+   */
+  explicit LockFreeQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1u;
+    _mask = size - 1;
+    _cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  LockFreeQueue(const LockFreeQueue &) = delete;
+  LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+  size_t capacity() const { return _mask + 1; }
+
+  /**
+   * Approximate number of queued elements.
+   */
+  size_t size() const {
+    size_t enqueuePosition = _enqueuePosition.load(std::memory_order_relaxed);
+    size_t dequeuePosition = _dequeuePosition.load(std::memory_order_relaxed);
+    return enqueuePosition > dequeuePosition ? enqueuePosition - dequeuePosition : 0;
+  }
+
+  /**
+   * @return false when the queue is full. "item" is left untouched then.
+   */
+  bool tryPush(T &item) {
+    Cell *cell = nullptr;
+    size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+      if (difference == 0) {
+        if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+      } else if (difference < 0) return false;
+      else position = _enqueuePosition.load(std::memory_order_relaxed);
+    }
+    cell->data = std::move(item);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @return false when the queue is empty.
+   */
+  bool tryPop(T &item) {
+    Cell *cell = nullptr;
+    size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+      if (difference == 0) {
+        if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+      } else if (difference < 0) return false;
+      else position = _dequeuePosition.load(std::memory_order_relaxed);
+    }
+    item = std::move(cell->data);
+    cell->data = T();
+    cell->sequence.store(position + _mask + 1, std::memory_order_release);
+    return true;
+  }
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> _cells;
+  size_t _mask = 0;
+  alignas(64) std::atomic<size_t> _enqueuePosition{0};
+  alignas(64) std::atomic<size_t> _dequeuePosition{0};
+};
+
+}
+
+#endif
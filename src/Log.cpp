@@ -0,0 +1,49 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "Log.h"
+
+namespace EnOcean {
+
+std::mutex Log::_repeatedMessagesMutex;
+std::unordered_map<uint64_t, Log::RepeatedMessageInfo> Log::_repeatedMessages;
+int64_t Log::_lastEviction = 0;
+
+bool Log::checkRepeated(RepeatedMessage message, uint64_t id, uint64_t &suppressedCount) {
+  try {
+    constexpr int64_t interval = 600000;
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    uint64_t key = ((uint64_t)message << 48u) | (id & 0xFFFFFFFFFFFFull);
+
+    std::lock_guard<std::mutex> repeatedMessagesGuard(_repeatedMessagesMutex);
+    auto infoIterator = _repeatedMessages.find(key);
+    if (infoIterator == _repeatedMessages.end()) {
+      if (_repeatedMessages.size() >= maxRepeatedMessages && time - _lastEviction >= 1000) {
+        //Messages whose interval is over are printed on their next occurrence anyway, so they are not needed anymore.
+        //At most one pass per second, so a map full of active messages doesn't cost a pass per call.
+        _lastEviction = time;
+        for (auto i = _repeatedMessages.begin(); i != _repeatedMessages.end();) {
+          if (time - i->second.lastPrinted >= interval) i = _repeatedMessages.erase(i);
+          else ++i;
+        }
+      }
+      //All tracked messages are still suppressed. The new message is printed without being tracked.
+      if (_repeatedMessages.size() >= maxRepeatedMessages) return true;
+      infoIterator = _repeatedMessages.emplace(key, RepeatedMessageInfo()).first;
+    }
+    auto &info = infoIterator->second;
+    if (info.lastPrinted != 0 && time - info.lastPrinted < interval) {
+      info.suppressedCount++;
+      return false;
+    }
+    suppressedCount = info.suppressedCount;
+    info.lastPrinted = time;
+    info.suppressedCount = 0;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return true;
+}
+
+}
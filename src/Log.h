@@ -0,0 +1,82 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include "Gd.h"
+
+#include <homegear-base/BaseLib.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace EnOcean {
+
+/**
+ * Logging for hot paths. The message builder is only called when the debug level is high enough, so no strings are
+ * formatted for messages that are not printed.
+ *
+ * Example: Log::info(_out, [&]() { return "Info: Sending packet " + BaseLib::HelperFunctions::getHexString(data); });
+ */
+class Log {
+ public:
+  enum class RepeatedMessage : uint32_t {
+    unencryptedAcceptedImplicitRlc = 1,
+    unencryptedAcceptedExplicitRlc = 2,
+    packetQueueFull = 3,
+    txQueueFull = 4
+  };
+
+  template<typename MessageBuilder>
+  static void error(BaseLib::Output &out, MessageBuilder &&messageBuilder) {
+    if (Gd::bl->debugLevel >= 2) out.printError(messageBuilder());
+  }
+
+  template<typename MessageBuilder>
+  static void warning(BaseLib::Output &out, MessageBuilder &&messageBuilder) {
+    if (Gd::bl->debugLevel >= 3) out.printWarning(messageBuilder());
+  }
+
+  template<typename MessageBuilder>
+  static void info(BaseLib::Output &out, MessageBuilder &&messageBuilder) {
+    if (Gd::bl->debugLevel >= 4) out.printInfo(messageBuilder());
+  }
+
+  template<typename MessageBuilder>
+  static void debug(BaseLib::Output &out, MessageBuilder &&messageBuilder) {
+    if (Gd::bl->debugLevel >= 5) out.printDebug(messageBuilder());
+  }
+
+  /**
+   * Prints a warning at most once per interval for each message and id (e. g. a peer ID). Suppressed occurrences are
+   * counted and the count is appended the next time the warning is printed.
+   */
+  template<typename MessageBuilder>
+  static void repeatedWarning(BaseLib::Output &out, RepeatedMessage message, uint64_t id, MessageBuilder &&messageBuilder) {
+    if (Gd::bl->debugLevel < 3) return;
+    uint64_t suppressedCount = 0;
+    if (!checkRepeated(message, id, suppressedCount)) return;
+    if (suppressedCount == 0) out.printWarning(messageBuilder());
+    else out.printWarning(messageBuilder() + " (suppressed " + std::to_string(suppressedCount) + " times since last message)");
+  }
+ private:
+  struct RepeatedMessageInfo {
+    int64_t lastPrinted = 0;
+    uint64_t suppressedCount = 0;
+  };
+
+  static constexpr size_t maxRepeatedMessages = 10000;
+
+  static std::mutex _repeatedMessagesMutex;
+  static std::unordered_map<uint64_t, RepeatedMessageInfo> _repeatedMessages;
+  static int64_t _lastEviction;
+
+  /**
+   * @return true when the message should be printed.
+   */
+  static bool checkRepeated(RepeatedMessage message, uint64_t id, uint64_t &suppressedCount);
+};
+
+}
+
+#endif
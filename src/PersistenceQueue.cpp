@@ -0,0 +1,77 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "PersistenceQueue.h"
+#include "Gd.h"
+
+namespace EnOcean {
+
+void PersistenceQueue::enqueue(uint64_t key, std::function<void()> write, uint32_t interval) {
+  try {
+    if (interval == 0) {
+      //Waits for a running flush, which might write an older value of this key.
+      std::lock_guard<std::mutex> flushGuard(_flushMutex);
+      {
+        std::lock_guard<std::mutex> writesGuard(_writesMutex);
+        //The queued write is outdated. The key stays in _order, flush() skips it.
+        _writes.erase(key);
+      }
+      write();
+      return;
+    }
+
+    std::lock_guard<std::mutex> writesGuard(_writesMutex);
+    if (_writes.empty()) _firstWriteTime = BaseLib::HelperFunctions::getTime();
+    auto writeIterator = _writes.find(key);
+    if (writeIterator == _writes.end()) {
+      _writes.emplace(key, std::move(write));
+      _order.push_back(key);
+    } else writeIterator->second = std::move(write);
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PersistenceQueue::flushIfDue(int64_t time, uint32_t interval) {
+  {
+    std::lock_guard<std::mutex> writesGuard(_writesMutex);
+    if (_writes.empty() || time - _firstWriteTime < interval) return;
+  }
+  flush();
+}
+
+void PersistenceQueue::flush() {
+  try {
+    std::lock_guard<std::mutex> flushGuard(_flushMutex);
+    std::vector<std::function<void()>> writes;
+
+    {
+      std::lock_guard<std::mutex> writesGuard(_writesMutex);
+      writes.reserve(_writes.size());
+      for (auto key : _order) {
+        auto writeIterator = _writes.find(key);
+        if (writeIterator == _writes.end()) continue;
+        writes.push_back(std::move(writeIterator->second));
+        _writes.erase(writeIterator);
+      }
+      _writes.clear();
+      _order.clear();
+    }
+
+    //Executed without holding _writesMutex, so new values can be queued meanwhile.
+    for (auto &write : writes) {
+      write();
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PersistenceQueue::clear() {
+  std::lock_guard<std::mutex> writesGuard(_writesMutex);
+  _writes.clear();
+  _order.clear();
+}
+
+}
@@ -0,0 +1,66 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef PERSISTENCEQUEUE_H_
+#define PERSISTENCEQUEUE_H_
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Write-behind queue for the database writes of one peer.
+ *
+ * Writes are queued by key (e. g. the database ID of a parameter). A newer write replaces a queued write with the same
+ * key, so a sensor sending every few seconds causes one database write per flush interval instead of one per
+ * telegram. Queued writes are executed together by flushIfDue() or flush().
+ *
+ * Durability policy: Values which can be recreated by the device (measured values, states) are deferred. Security
+ * related data (rolling codes, keys) must never be deferred, as losing it means reusing rolling codes or accepting
+ * replayed telegrams. Callers write these directly without the queue.
+ *
+ * A flush executes the queued writes one after another. The database interface of BaseLib offers modules no
+ * transactions, so they are not written in one transaction.
+ */
+class PersistenceQueue {
+ public:
+  /**
+   * Keys of variables and parameters must not collide, so parameter keys have this bit set.
+   */
+  static constexpr uint64_t parameterKey = 1ull << 63u;
+
+  /**
+   * @param interval Maximum time in milliseconds a write is deferred. 0 executes all writes right away.
+   */
+  void enqueue(uint64_t key, std::function<void()> write, uint32_t interval);
+
+  /**
+   * Executes the queued writes when the oldest one has been queued for longer than "interval".
+   */
+  void flushIfDue(int64_t time, uint32_t interval);
+
+  /**
+   * Executes all queued writes. Flushes are serialized, so writes to the same key are never reordered.
+   */
+  void flush();
+
+  /**
+   * Drops all queued writes, e. g. when the peer is deleted.
+   */
+  void clear();
+ private:
+  //Held while writes are executed.
+  std::mutex _flushMutex;
+  std::mutex _writesMutex;
+  std::unordered_map<uint64_t, std::function<void()>> _writes;
+  //Keeps the order of the first write per key.
+  std::vector<uint64_t> _order;
+  int64_t _firstWriteTime = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "DutyCycleEstimator.h"
+
+namespace EnOcean {
+
+void DutyCycleEstimator::setDutyCycle(double dutyCycle) {
+  if (dutyCycle <= 0 || dutyCycle > 100) dutyCycle = 1;
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  //Airtime in microseconds per hour
+  _budget = (int64_t)(dutyCycle * 36000000.0);
+}
+
+void DutyCycleEstimator::advance(int64_t time) {
+  //_currentBucket is the absolute minute. Buckets of minutes which left the window are cleared.
+  int64_t bucket = time / bucketDuration;
+  if (bucket <= _currentBucket) return;
+  if (bucket - _currentBucket >= bucketCount) _buckets.fill(0);
+  else {
+    for (int64_t i = _currentBucket + 1; i <= bucket; i++) {
+      _buckets[i % bucketCount] = 0;
+    }
+  }
+  _currentBucket = bucket;
+}
+
+int64_t DutyCycleEstimator::getUsedAirtime() {
+  int64_t usedAirtime = 0;
+  for (auto airtime : _buckets) {
+    usedAirtime += airtime;
+  }
+  return usedAirtime;
+}
+
+void DutyCycleEstimator::addTransmission(uint32_t airtime, int64_t time) {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  advance(time);
+  _buckets[_currentBucket % bucketCount] += airtime;
+}
+
+void DutyCycleEstimator::sync(uint32_t dutyCycleUsed, int64_t time) {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  advance(time);
+  if (dutyCycleUsed > 100) dutyCycleUsed = 100;
+  int64_t reportedAirtime = _budget * dutyCycleUsed / 100;
+  int64_t difference = reportedAirtime - getUsedAirtime();
+  if (difference >= 0) {
+    _buckets[_currentBucket % bucketCount] += difference;
+    return;
+  }
+
+  //The module used less than estimated (e. g. after a reset). Remove the difference starting with the oldest minute.
+  for (int64_t i = _currentBucket + 1; i <= _currentBucket + bucketCount && difference < 0; i++) {
+    auto &airtime = _buckets[i % bucketCount];
+    if (airtime <= -difference) {
+      difference += airtime;
+      airtime = 0;
+    } else {
+      airtime += difference;
+      difference = 0;
+    }
+  }
+}
+
+uint32_t DutyCycleEstimator::getDutyCycleUsed(int64_t time) {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  advance(time);
+  if (_budget <= 0) return 100;
+  int64_t dutyCycleUsed = (getUsedAirtime() * 100 + _budget - 1) / _budget;
+  return dutyCycleUsed > 100 ? 100 : (uint32_t)dutyCycleUsed;
+}
+
+int64_t DutyCycleEstimator::getRemainingAirtime(int64_t time) {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  advance(time);
+  int64_t remainingAirtime = _budget - getUsedAirtime();
+  return remainingAirtime > 0 ? remainingAirtime : 0;
+}
+
+int64_t DutyCycleEstimator::getBudget() {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  return _budget;
+}
+
+uint32_t DutyCycleEstimator::getTimeUntilRelease(int64_t time) {
+  std::lock_guard<std::mutex> bucketsGuard(_bucketsMutex);
+  advance(time);
+  for (int64_t i = _currentBucket + 1; i <= _currentBucket + bucketCount; i++) {
+    if (_buckets[i % bucketCount] == 0) continue;
+    //Bucket "i - bucketCount" leaves the window at the start of minute "i".
+    return (uint32_t)((i * bucketDuration - time + 999) / 1000);
+  }
+  return 0;
+}
+
+}
@@ -0,0 +1,74 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef DUTYCYCLEESTIMATOR_H_
+#define DUTYCYCLEESTIMATOR_H_
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+namespace EnOcean {
+
+/**
+ * Local model of the duty cycle the module has used.
+ *
+ * The airtime of every transmitted telegram is added to one of 60 one-minute buckets, which together form the
+ * sliding one-hour window the duty cycle limit refers to. Querying the estimate costs no serial round trip. sync()
+ * aligns the estimate with the value reported by the module, which also covers telegrams we don't know about
+ * (e. g. sent by the module's repeater).
+ */
+class DutyCycleEstimator {
+ public:
+  static constexpr uint32_t bucketCount = 60;
+  static constexpr int64_t bucketDuration = 60000;
+
+  /**
+   * @param dutyCycle Allowed duty cycle in percent.
+   */
+  void setDutyCycle(double dutyCycle);
+
+  /**
+   * @param airtime The airtime in microseconds.
+   * @param time The time in milliseconds.
+   */
+  void addTransmission(uint32_t airtime, int64_t time);
+
+  /**
+   * Sets the estimate to the value reported by the module.
+   *
+   * @param dutyCycleUsed Used part of the budget in percent.
+   */
+  void sync(uint32_t dutyCycleUsed, int64_t time);
+
+  /**
+   * @return Used part of the budget within the last hour in percent. Rounded up.
+   */
+  uint32_t getDutyCycleUsed(int64_t time);
+
+  /**
+   * @return The remaining airtime budget in microseconds.
+   */
+  int64_t getRemainingAirtime(int64_t time);
+
+  /**
+   * @return The airtime budget of one hour in microseconds.
+   */
+  int64_t getBudget();
+
+  /**
+   * @return Seconds until the oldest transmissions leave the window and free up budget. 0 when nothing was sent.
+   */
+  uint32_t getTimeUntilRelease(int64_t time);
+ private:
+  std::mutex _bucketsMutex;
+  std::array<int64_t, bucketCount> _buckets{};
+  int64_t _currentBucket = 0;
+  int64_t _budget = 36000000;
+
+  void advance(int64_t time);
+  int64_t getUsedAirtime();
+};
+
+}
+
+#endif
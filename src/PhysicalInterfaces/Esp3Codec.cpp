@@ -0,0 +1,163 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "Esp3Codec.h"
+
+#include <array>
+#include <chrono>
+#include <random>
+
+namespace EnOcean {
+
+namespace {
+
+typedef std::array<std::array<uint8_t, 256>, 4> Crc8Tables;
+
+constexpr Crc8Tables createCrc8Tables() {
+  Crc8Tables tables{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint8_t crc = (uint8_t)i;
+    for (uint32_t j = 0; j < 8; j++) {
+      crc = (crc & 0x80u) ? (uint8_t)((crc << 1u) ^ 0x07u) : (uint8_t)(crc << 1u);
+    }
+    tables[0][i] = crc;
+  }
+  //tables[n][i] is the CRC of byte i followed by n zero bytes
+  for (uint32_t n = 1; n < 4; n++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      tables[n][i] = tables[0][tables[n - 1][i]];
+    }
+  }
+  return tables;
+}
+
+constexpr Crc8Tables crc8Tables = createCrc8Tables();
+
+static_assert(crc8Tables[0][1] == 0x07 && crc8Tables[0][0xFF] == 0xF3, "Wrong CRC8 table.");
+
+}
+
+uint8_t Esp3Codec::crc8Bytewise(const uint8_t *data, size_t size, uint8_t crc) {
+  for (size_t i = 0; i < size; i++) {
+    crc = crc8Tables[0][crc ^ data[i]];
+  }
+  return crc;
+}
+
+uint8_t Esp3Codec::crc8(const uint8_t *data, size_t size, uint8_t crc) {
+  const uint8_t *end = data + size;
+  while (end - data >= 4) {
+    crc = crc8Tables[3][crc ^ data[0]] ^ crc8Tables[2][data[1]] ^ crc8Tables[1][data[2]] ^ crc8Tables[0][data[3]];
+    data += 4;
+  }
+  while (data < end) {
+    crc = crc8Tables[0][crc ^ *data];
+    data++;
+  }
+  return crc;
+}
+
+bool Esp3Codec::checkHeader(const uint8_t *frame, size_t size) {
+  if (size < 6 || frame[0] != 0x55) return false;
+  return crc8(frame + 1, 4) == frame[5];
+}
+
+bool Esp3Codec::checkFrame(const uint8_t *frame, size_t size) {
+  if (!checkHeader(frame, size)) return false;
+  size_t dataSize = (((size_t)frame[1] << 8u) | frame[2]) + frame[3];
+  if (dataSize == 0 || dataSize + 7 != size) return false;
+  return crc8(frame + 6, dataSize) == frame[size - 1];
+}
+
+size_t Esp3Codec::checkFrames(const std::vector<std::vector<uint8_t>> &frames, std::vector<uint8_t> &results) {
+  size_t validFrames = 0;
+  results.resize(frames.size());
+  for (size_t i = 0; i < frames.size(); i++) {
+    results[i] = checkFrame(frames[i]) ? 1 : 0;
+    validFrames += results[i];
+  }
+  return validFrames;
+}
+
+size_t Esp3Codec::findFrames(const uint8_t *buffer, size_t size, std::vector<std::pair<size_t, size_t>> &frames) {
+  size_t validFrames = 0;
+  size_t position = 0;
+  while (position + 6 < size) {
+    if (buffer[position] != 0x55 || !checkHeader(buffer + position, size - position)) {
+      position++;
+      continue;
+    }
+    size_t frameSize = (((size_t)buffer[position + 1] << 8u) | buffer[position + 2]) + buffer[position + 3] + 7;
+    if (frameSize > 7 && position + frameSize <= size && checkFrame(buffer + position, frameSize)) {
+      frames.emplace_back(position, frameSize);
+      validFrames++;
+      position += frameSize;
+    } else position++;
+  }
+  return validFrames;
+}
+
+void Esp3Codec::finalize(std::vector<uint8_t> &frame) {
+  if (frame.size() < 6) return;
+  frame[5] = crc8(frame.data() + 1, 4);
+  if (frame.size() > 6) frame.back() = crc8(frame.data() + 6, frame.size() - 7);
+}
+
+Esp3Codec::BenchmarkResult Esp3Codec::benchmark(uint32_t frameCount, uint32_t rounds) {
+  BenchmarkResult result;
+  if (frameCount == 0 || rounds == 0) return result;
+
+  //Typical sizes of ERP1 frames (4BS, VLD, REMAN)
+  std::mt19937 generator(frameCount);
+  std::uniform_int_distribution<uint32_t> sizeDistribution(6, 30);
+  std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+  std::vector<std::vector<uint8_t>> frames;
+  frames.reserve(frameCount);
+  for (uint32_t i = 0; i < frameCount; i++) {
+    uint32_t dataSize = sizeDistribution(generator);
+    std::vector<uint8_t> frame(dataSize + 7 + 7);
+    frame[0] = 0x55;
+    frame[1] = 0;
+    frame[2] = (uint8_t)dataSize;
+    frame[3] = 7;
+    frame[4] = 1;
+    for (size_t j = 6; j < frame.size() - 1; j++) {
+      frame[j] = (uint8_t)byteDistribution(generator);
+    }
+    finalize(frame);
+    result.bytes += frame.size();
+    frames.push_back(std::move(frame));
+  }
+  result.frames = (uint64_t)frameCount * rounds;
+  result.bytes *= rounds;
+
+  //The checksum keeps the compiler from removing the loops.
+  volatile uint32_t checksum = 0;
+
+  auto startTime = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (auto &frame : frames) {
+      bool valid = crc8Bytewise(frame.data() + 1, 4) == frame[5] && crc8Bytewise(frame.data() + 6, frame.size() - 7) == frame.back();
+      checksum = checksum + (valid ? 1 : 0);
+    }
+  }
+  result.bytewiseNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  startTime = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (auto &frame : frames) {
+      checksum = checksum + (checkFrame(frame) ? 1 : 0);
+    }
+  }
+  result.slicedNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  std::vector<uint8_t> results;
+  startTime = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    checksum = checksum + checkFrames(frames, results);
+  }
+  result.batchNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  return result;
+}
+
+}
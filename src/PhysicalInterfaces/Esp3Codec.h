@@ -0,0 +1,75 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef ESP3CODEC_H_
+#define ESP3CODEC_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Validates and encodes ESP3 frames. Shared by all interface types.
+ *
+ * The CRC8 (polynomial 0x07) uses constexpr-generated tables and processes four bytes per step (slicing-by-4).
+ */
+class Esp3Codec {
+ public:
+  struct BenchmarkResult {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t bytewiseNanoseconds = 0;
+    uint64_t slicedNanoseconds = 0;
+    uint64_t batchNanoseconds = 0;
+  };
+
+  static uint8_t crc8(const uint8_t *data, size_t size, uint8_t crc = 0);
+
+  /**
+   * The plain table loop (one byte per step). Only used as reference.
+   */
+  static uint8_t crc8Bytewise(const uint8_t *data, size_t size, uint8_t crc = 0);
+
+  /**
+   * Checks sync byte and header CRC. Needs at least 6 bytes.
+   */
+  static bool checkHeader(const uint8_t *frame, size_t size);
+
+  /**
+   * Checks sync byte, header CRC, size information and data CRC of a complete frame.
+   */
+  static bool checkFrame(const uint8_t *frame, size_t size);
+  static bool checkFrame(const std::vector<uint8_t> &frame) { return checkFrame(frame.data(), frame.size()); }
+
+  /**
+   * Checks many frames at once. "results" is set to 1 for each valid frame and to 0 otherwise.
+   *
+   * @return The number of valid frames.
+   */
+  static size_t checkFrames(const std::vector<std::vector<uint8_t>> &frames, std::vector<uint8_t> &results);
+
+  /**
+   * Finds all valid frames in a buffer containing concatenated frames (e. g. a replayed capture). Garbage between
+   * frames is skipped.
+   *
+   * @param frames Filled with offset and size of each valid frame.
+   * @return The number of valid frames.
+   */
+  static size_t findFrames(const uint8_t *buffer, size_t size, std::vector<std::pair<size_t, size_t>> &frames);
+
+  /**
+   * Sets header and data CRC of a frame.
+   */
+  static void finalize(std::vector<uint8_t> &frame);
+
+  /**
+   * Compares the byte-wise loop with the sliced implementation on random frames.
+   */
+  static BenchmarkResult benchmark(uint32_t frameCount, uint32_t rounds);
+};
+
+}
+
+#endif
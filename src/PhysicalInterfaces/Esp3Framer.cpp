@@ -0,0 +1,103 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "Esp3Framer.h"
+#include "Esp3Codec.h"
+
+#include <cstring>
+
+namespace EnOcean {
+
+Esp3Framer::Esp3Framer(size_t capacity) {
+  size_t size = 64;
+  while (size < capacity) size <<= 1u;
+  _buffer.resize(size, 0);
+  _mask = size - 1;
+}
+
+std::pair<uint8_t *, size_t> Esp3Framer::writeRegion() {
+  size_t free = _buffer.size() - size();
+  size_t offset = _tail & _mask;
+  size_t contiguous = _buffer.size() - offset;
+  return std::make_pair(_buffer.data() + offset, contiguous < free ? contiguous : free);
+}
+
+void Esp3Framer::commit(size_t size) {
+  size_t free = _buffer.size() - this->size();
+  _tail += (size > free ? free : size);
+}
+
+size_t Esp3Framer::write(const uint8_t *data, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    auto region = writeRegion();
+    if (region.second == 0) break;
+    size_t bytes = size - written < region.second ? size - written : region.second;
+    std::memcpy(region.first, data + written, bytes);
+    commit(bytes);
+    written += bytes;
+  }
+  return written;
+}
+
+void Esp3Framer::clear() {
+  _head = 0;
+  _tail = 0;
+}
+
+void Esp3Framer::drop(size_t size) {
+  _head += size;
+  if (_head == _tail) clear();
+}
+
+void Esp3Framer::copyOut(size_t size, std::vector<uint8_t> &target) const {
+  target.resize(size);
+  size_t offset = _head & _mask;
+  size_t first = _buffer.size() - offset;
+  if (first >= size) std::memcpy(target.data(), _buffer.data() + offset, size);
+  else {
+    std::memcpy(target.data(), _buffer.data() + offset, first);
+    std::memcpy(target.data() + first, _buffer.data(), size - first);
+  }
+}
+
+uint8_t Esp3Framer::crc8(size_t offset, size_t size) const {
+  //The region can wrap around the end of the ring buffer
+  size_t start = (_head + offset) & _mask;
+  size_t first = _buffer.size() - start;
+  if (first >= size) return Esp3Codec::crc8(_buffer.data() + start, size);
+  uint8_t crc = Esp3Codec::crc8(_buffer.data() + start, first);
+  return Esp3Codec::crc8(_buffer.data(), size - first, crc);
+}
+
+Esp3Framer::Result Esp3Framer::nextFrame(std::vector<uint8_t> &frame) {
+  //Skip everything up to the next sync byte
+  while (size() > 0 && at(0) != 0x55) drop(1);
+  if (size() < 6) return Result::needMoreData;
+
+  if (crc8(1, 4) != at(5)) {
+    copyOut(6, frame);
+    drop(1);
+    return Result::headerCrcError;
+  }
+
+  size_t frameSize = (((size_t)at(1) << 8u) | at(2)) + at(3);
+  if (frameSize == 0 || frameSize + 7 > _buffer.size()) {
+    copyOut(6, frame);
+    drop(1);
+    return Result::invalidSize;
+  }
+  frameSize += 7;
+  if (size() < frameSize) return Result::needMoreData;
+
+  if (crc8(6, frameSize - 7) != at(frameSize - 1)) {
+    copyOut(frameSize, frame);
+    drop(1);
+    return Result::dataCrcError;
+  }
+
+  copyOut(frameSize, frame);
+  drop(frameSize);
+  return Result::frame;
+}
+
+}
@@ -0,0 +1,74 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef ESP3FRAMER_H_
+#define ESP3FRAMER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Splits a raw ESP3 byte stream into frames.
+ *
+ * Bytes are written directly into a ring buffer (see writeRegion() and commit()), so a whole burst can be read from
+ * the device with one system call. Sync byte, header CRC and data CRC are checked in place; only valid frames are
+ * copied out. After a CRC or size error only the sync byte is dropped, so a valid frame starting inside the garbage
+ * is still found.
+ */
+class Esp3Framer {
+ public:
+  enum class Result {
+    needMoreData,
+    frame,
+    headerCrcError,
+    dataCrcError,
+    invalidSize
+  };
+
+  /**
+   * @param capacity Size of the ring buffer. Rounded up to a power of two. Frames larger than this are rejected.
+   */
+  explicit Esp3Framer(size_t capacity = 4096);
+
+  /**
+   * Returns the largest contiguous free region at the write position. Fill it and call commit().
+   */
+  std::pair<uint8_t *, size_t> writeRegion();
+  void commit(size_t size);
+
+  /**
+   * Copies data into the ring buffer. Returns the number of bytes actually stored.
+   */
+  size_t write(const uint8_t *data, size_t size);
+
+  /**
+   * Extracts the next frame. On Result::frame "frame" contains the complete ESP3 packet including sync byte and CRCs.
+   * On errors "frame" contains the offending bytes for logging. Call repeatedly until Result::needMoreData is returned.
+   */
+  Result nextFrame(std::vector<uint8_t> &frame);
+
+  /**
+   * Discards all buffered bytes.
+   */
+  void clear();
+
+  size_t size() const { return _tail - _head; }
+  size_t capacity() const { return _buffer.size(); }
+ private:
+  std::vector<uint8_t> _buffer;
+  size_t _mask = 0;
+  size_t _head = 0;
+  size_t _tail = 0;
+
+  uint8_t at(size_t index) const { return _buffer[(_head + index) & _mask]; }
+  void drop(size_t size);
+  void copyOut(size_t size, std::vector<uint8_t> &target) const;
+  uint8_t crc8(size_t offset, size_t size) const;
+};
+
+}
+
+#endif
@@ -2,6 +2,8 @@
 
 #include "../Gd.h"
 #include "Hgdc.h"
+#include "Esp3Codec.h"
+#include "../Log.h"
 
 namespace EnOcean {
 
@@ -31,6 +33,7 @@ void Hgdc::startListening() {
                                                                                                                                                                       std::placeholders::_1,
                                                                                                                                                                       std::placeholders::_2,
                                                                                                                                                                       std::placeholders::_3)));
+    startTxScheduler();
     IPhysicalInterface::startListening();
 
     _stopped = false;
@@ -43,6 +46,7 @@ void Hgdc::startListening() {
 
 void Hgdc::stopListening() {
   try {
+    stopTxScheduler();
     _stopped = true;
     IPhysicalInterface::stopListening();
     Gd::bl->hgdc->unregisterPacketReceivedEventHandler(_packetReceivedEventHandlerId);
@@ -186,7 +190,7 @@ int32_t Hgdc::setBaseAddress(uint32_t value) {
   return -1;
 }
 
-IEnOceanInterface::DutyCycleInfo Hgdc::getDutyCycleInfo() {
+IEnOceanInterface::DutyCycleInfo Hgdc::readDutyCycleInfo() {
   try {
     std::vector<uint8_t> response;
     for (int32_t i = 0; i < 10; i++) {
@@ -201,6 +205,7 @@ IEnOceanInterface::DutyCycleInfo Hgdc::getDutyCycleInfo() {
       }
 
       DutyCycleInfo info;
+      info.valid = true;
       info.dutyCycleUsed = response[7];
       info.slotPeriod = (((uint32_t)response[9]) << 8) | response[10];
       info.timeLeftInSlot = (((uint32_t)response[11]) << 8) | response[12];
@@ -216,6 +221,10 @@ IEnOceanInterface::DutyCycleInfo Hgdc::getDutyCycleInfo() {
 
 bool Hgdc::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
   try {
+    //All chunks are written back to back. The responses are collected afterwards, so a multi-chunk packet doesn't cost
+    //one serial round trip per chunk.
+    std::vector<std::pair<std::vector<uint8_t>, std::future<std::vector<uint8_t>>>> pendingResponses;
+    pendingResponses.reserve(packets.size());
     uint32_t i = 0;
     for (auto &packet: packets) {
       i++;
@@ -225,13 +234,19 @@ bool Hgdc::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
       addCrc8(data);
 
       if (packet->getRorg() == 0xC5) {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") " + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") " + BaseLib::HelperFunctions::getHexString(data); });
       } else {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data); });
       }
 
+      auto future = queueSerialCommand(0x02, data);
+      pendingResponses.emplace_back(std::move(data), std::move(future));
+    }
+
+    for (auto &pendingResponse : pendingResponses) {
+      auto &data = pendingResponse.first;
       std::vector<uint8_t> response;
-      getResponse(0x02, data, response);
+      waitForSerialResponse(pendingResponse.second, data, response);
       if (response.size() != 8 || (response.size() >= 7 && response[6] != 0)) {
         if (response.size() >= 7 && response[6] != 0) {
           auto statusIterator = _responseStatusCodes.find(response[6]);
@@ -252,7 +267,6 @@ bool Hgdc::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
 
 void Hgdc::rawSend(std::vector<uint8_t> &packet) {
   try {
-    IEnOceanInterface::rawSend(packet);
     if (!Gd::bl->hgdc->sendPacket(_settings->serialNumber, packet)) {
       _out.printError("Error sending packet " + BaseLib::HelperFunctions::getHexString(packet) + ".");
     }
@@ -271,24 +285,10 @@ void Hgdc::processPacket(int64_t familyId, const std::string &serialNumber, cons
       return;
     }
 
-    {
-      uint8_t crc8 = 0;
-      for (int32_t i = 1; i < 5; i++) {
-        crc8 = _crc8Table[crc8 ^ (uint8_t)data[i]];
-      }
-      if (crc8 != data[5]) {
-        _out.printError("Error: CRC (0x" + BaseLib::HelperFunctions::getHexString(crc8, 2) + ") failed for header: " + BaseLib::HelperFunctions::getHexString(data));
-        return;
-      }
-
-      crc8 = 0;
-      for (uint32_t i = 6; i < data.size() - 1; i++) {
-        crc8 = _crc8Table[crc8 ^ (uint8_t)data[i]];
-      }
-      if (crc8 != data.back()) {
-        _out.printError("Error: CRC failed for packet: " + BaseLib::HelperFunctions::getHexString(data));
-        return;
-      }
+    //Checks the header, too.
+    if (!Esp3Codec::checkFrame(data)) {
+      _out.printError("Error: Invalid packet (header CRC, size or data CRC): " + BaseLib::HelperFunctions::getHexString(data));
+      return;
     }
 
     if (Gd::bl->debugLevel >= 5) _out.printDebug("Debug: Serial packet received: " + BaseLib::HelperFunctions::getHexString(data));
@@ -297,13 +297,13 @@ void Hgdc::processPacket(int64_t familyId, const std::string &serialNumber, cons
 
     if (checkForSerialRequest(data)) return;
 
-    auto packet = std::make_shared<EnOceanPacket>(data);
+    PEnOceanPacket packet = _packetPool.get(data);
     if (checkForEnOceanRequest(packet)) return;
     if (packet->getType() == EnOceanPacket::Type::RADIO_ERP1 || packet->getType() == EnOceanPacket::Type::RADIO_ERP2) {
       if ((packet->senderAddress() & 0xFFFFFF80) == _baseAddress && Gd::bl->debugLevel >= 5) _out.printDebug("Debug: Ignoring packet from myself: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
       else raisePacketReceived(packet);
     } else {
-      _out.printInfo("Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(data));
+      Log::info(_out, [&]() { return "Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(data); });
     }
   }
   catch (const std::exception &ex) {
@@ -23,7 +23,6 @@ class Hgdc : public IEnOceanInterface {
   void reset() override;
 
   int32_t setBaseAddress(uint32_t value) override;
-  DutyCycleInfo getDutyCycleInfo() override;
 
   bool isOpen() override { return !_stopped && _initComplete; }
   std::string getSerialNumber() override { return _settings->serialNumber; }
@@ -37,6 +36,7 @@ class Hgdc : public IEnOceanInterface {
   std::string _firmwareVersion;
 
   void rawSend(std::vector<uint8_t> &packet) override;
+  DutyCycleInfo readDutyCycleInfo() override;
   void processPacket(int64_t familyId, const std::string &serialNumber, const std::vector<uint8_t> &data);
 };
 
@@ -2,6 +2,7 @@
 
 #include "../Gd.h"
 #include "HomegearGateway.h"
+#include "../Log.h"
 
 namespace EnOcean {
 
@@ -55,6 +56,7 @@ void HomegearGateway::startListening() {
     _stopCallbackThread = false;
     if (_settings->listenThreadPriority > -1) _bl->threadManager.start(_listenThread, true, _settings->listenThreadPriority, _settings->listenThreadPolicy, &HomegearGateway::listen, this);
     else _bl->threadManager.start(_listenThread, true, &HomegearGateway::listen, this);
+    startTxScheduler();
     IPhysicalInterface::startListening();
   }
   catch (const std::exception &ex) {
@@ -64,6 +66,7 @@ void HomegearGateway::startListening() {
 
 void HomegearGateway::stopListening() {
   try {
+    stopTxScheduler();
     _stopCallbackThread = true;
     if (_tcpSocket) _tcpSocket->Shutdown();
     _bl->threadManager.join(_listenThread);
@@ -103,14 +106,10 @@ int32_t HomegearGateway::setBaseAddress(uint32_t value) {
   return -1;
 }
 
-IEnOceanInterface::DutyCycleInfo HomegearGateway::getDutyCycleInfo() {
+IEnOceanInterface::DutyCycleInfo HomegearGateway::readDutyCycleInfo() {
   try {
-    if (!_tcpSocket->Connected()) {
-      _out.printError("Error: Could not set base address. Not connected to gateway.");
-      return DutyCycleInfo();
-    }
-
-    Gd::out.printError("Error: getDutyCycleInfo is not supported yet.");
+    //Not supported by the gateway yet. Only the local estimate is used.
+    Log::debug(_out, [&]() { return "Debug: Reading duty cycle information is not supported by Homegear Gateway."; });
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -247,6 +246,10 @@ bool HomegearGateway::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packe
       }
     }
 
+    //All chunks are written back to back. The responses are collected afterwards, so a multi-chunk packet doesn't cost
+    //one serial round trip per chunk.
+    std::vector<std::pair<std::vector<uint8_t>, std::future<std::vector<uint8_t>>>> pendingResponses;
+    pendingResponses.reserve(packets.size());
     uint32_t i = 0;
     for (auto &packet: packets) {
       i++;
@@ -256,14 +259,20 @@ bool HomegearGateway::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packe
       addCrc8(data);
 
       if (packet->getRorg() == 0xC5) {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") "
-                              + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") "
+                              + BaseLib::HelperFunctions::getHexString(data); });
       } else {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data); });
       }
 
+      auto future = queueSerialCommand(0x02, data);
+      pendingResponses.emplace_back(std::move(data), std::move(future));
+    }
+
+    for (auto &pendingResponse : pendingResponses) {
+      auto &data = pendingResponse.first;
       std::vector<uint8_t> response;
-      getResponse(0x02, data, response);
+      waitForSerialResponse(pendingResponse.second, data, response);
       if (response.size() != 8 || (response.size() >= 7 && response[6] != 0)) {
         if (response.size() >= 7 && response[6] != 0) {
           std::map<uint8_t, std::string>::iterator statusIterator = _responseStatusCodes.find(response[6]);
@@ -284,7 +293,6 @@ bool HomegearGateway::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packe
 
 void HomegearGateway::rawSend(std::vector<uint8_t> &packet) {
   try {
-    IEnOceanInterface::rawSend(packet);
     if (!_tcpSocket || !_tcpSocket->Connected()) return;
 
     BaseLib::PArray parameters = std::make_shared<BaseLib::Array>();
@@ -353,13 +361,13 @@ void HomegearGateway::processPacket(std::vector<uint8_t> &data) {
 
     if (checkForSerialRequest(data)) return;
 
-    PEnOceanPacket packet(new EnOceanPacket(data));
+    PEnOceanPacket packet = _packetPool.get(data);
     if (checkForEnOceanRequest(packet)) return;
     if (packet->getType() == EnOceanPacket::Type::RADIO_ERP1 || packet->getType() == EnOceanPacket::Type::RADIO_ERP2) {
-      if ((packet->senderAddress() & 0xFFFFFF80) == _baseAddress) _out.printInfo("Info: Ignoring packet from myself: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
+      if ((packet->senderAddress() & 0xFFFFFF80) == _baseAddress) Log::info(_out, [&]() { return "Info: Ignoring packet from myself: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
       else raisePacketReceived(packet);
     } else {
-      _out.printInfo("Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(data));
+      Log::info(_out, [&]() { return "Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
     }
   }
   catch (const std::exception &ex) {
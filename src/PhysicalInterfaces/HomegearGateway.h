@@ -22,7 +22,6 @@ class HomegearGateway : public IEnOceanInterface {
   void stopListening() override;
 
   int32_t setBaseAddress(uint32_t value) override;
-  DutyCycleInfo getDutyCycleInfo() override;
 
   bool isOpen() override { return !_stopped; }
 
@@ -42,6 +41,7 @@ class HomegearGateway : public IEnOceanInterface {
 
   void listen();
   void rawSend(std::vector<uint8_t> &packet) override;
+  DutyCycleInfo readDutyCycleInfo() override;
   PVariable invoke(std::string methodName, PArray &parameters);
   void processPacket(std::vector<uint8_t> &data);
   void init();
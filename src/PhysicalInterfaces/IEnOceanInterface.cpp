@@ -1,9 +1,14 @@
 /* Copyright 2013-2019 Homegear GmbH */
 
 #include "IEnOceanInterface.h"
+#include "Esp3Codec.h"
+#include "../Log.h"
 #include "../Gd.h"
 #include "../EnOceanPacket.h"
 
+#include <algorithm>
+#include <array>
+
 namespace EnOcean {
 
 IEnOceanInterface::IEnOceanInterface(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : IPhysicalInterface(Gd::bl, Gd::family->getFamily(), settings) {
@@ -28,39 +33,130 @@ IEnOceanInterface::~IEnOceanInterface() {
 
 }
 
-void IEnOceanInterface::getResponse(uint8_t packetType, std::vector<uint8_t> &requestPacket, std::vector<uint8_t> &responsePacket) {
+void IEnOceanInterface::expireSerialRequests(int64_t time, std::vector<std::shared_ptr<SerialRequest>> &expiredRequests) {
+  //Needs to be called with _serialRequestsMutex locked. The requests are sorted by send time, so only the front needs to be checked.
+  while (!_serialRequests.empty() && time - _serialRequests.front()->sendTime >= _serialResponseTimeout) {
+    expiredRequests.push_back(_serialRequests.front());
+    _serialRequests.pop_front();
+  }
+}
+
+std::future<std::vector<uint8_t>> IEnOceanInterface::queueSerialCommand(uint8_t packetType, std::vector<uint8_t> &requestPacket, SerialResponseCallback callback) {
+  auto request = std::make_shared<SerialRequest>();
+  auto future = request->response.get_future();
   try {
-    if (_stopped) return;
-    responsePacket.clear();
+    request->packetType = packetType;
+    request->callback = std::move(callback);
+    if (_stopped) {
+      request->response.set_value(std::vector<uint8_t>());
+      return future;
+    }
+
+    if (requestPacket.size() > 6 && requestPacket[4] == 0x01) {
+      //Radio telegrams are written by the TX scheduler. The request is registered when the telegram goes on the wire.
+      auto transmit = [this, request](std::vector<uint8_t> &frame, bool dropped) {
+        if (dropped) {
+          request->response.set_value(std::vector<uint8_t>());
+          return;
+        }
+        _dutyCycleEstimator.addTransmission(TxScheduler::getAirtime(frame), BaseLib::HelperFunctions::getTime());
+        sendSerialRequest(request, frame);
+      };
+      if (!_txScheduler.enqueue(TxScheduler::getPriority(requestPacket), requestPacket, transmit)) {
+        Log::repeatedWarning(_out, Log::RepeatedMessage::txQueueFull, _handle, [&]() { return "Warning: Could not queue packet. TX queue is full or interface is not running."; });
+        Log::debug(_out, [&]() { return "Debug: Packet not queued: " + BaseLib::HelperFunctions::getHexString(requestPacket); });
+        request->response.set_value(std::vector<uint8_t>());
+      }
+      return future;
+    }
 
-    std::shared_ptr<SerialRequest> request = std::make_shared<SerialRequest>();
-    std::unique_lock<std::mutex> getResponseGuard(_getResponseMutex, std::defer_lock);
-    std::unique_lock<std::mutex> requestsGuard(_serialRequestsMutex, std::defer_lock);
-    std::lock(getResponseGuard, requestsGuard);
+    sendSerialRequest(request, requestPacket);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return future;
+}
 
-    _serialRequests[packetType] = request;
-    requestsGuard.unlock();
+void IEnOceanInterface::sendSerialRequest(const std::shared_ptr<SerialRequest> &request, std::vector<uint8_t> &requestPacket) {
+  try {
+    std::vector<std::shared_ptr<SerialRequest>> expiredRequests;
+    {
+      //Holding _serialSendMutex while sending makes sure the order in _serialRequests is the order on the wire.
+      std::lock_guard<std::mutex> sendGuard(_serialSendMutex);
+      {
+        std::unique_lock<std::mutex> requestsGuard(_serialRequestsMutex);
+        expireSerialRequests(BaseLib::HelperFunctions::getTime(), expiredRequests);
+        if (_serialRequests.size() >= _maxSerialCommandsInFlight) {
+          _serialRequestsConditionVariable.wait_for(requestsGuard, std::chrono::milliseconds(_serialResponseTimeout), [&] { return _serialRequests.size() < _maxSerialCommandsInFlight; });
+          expireSerialRequests(BaseLib::HelperFunctions::getTime(), expiredRequests);
+        }
+        request->sendTime = BaseLib::HelperFunctions::getTime();
+        _serialRequests.push_back(request);
+      }
 
-    try {
-      rawSend(requestPacket);
+      try {
+        rawSend(requestPacket);
+      }
+      catch (const std::exception &ex) {
+        _out.printError("Error sending packet: " + std::string(ex.what()));
+        std::lock_guard<std::mutex> requestsGuard(_serialRequestsMutex);
+        auto requestIterator = std::find(_serialRequests.begin(), _serialRequests.end(), request);
+        if (requestIterator != _serialRequests.end()) {
+          _serialRequests.erase(requestIterator);
+          expiredRequests.push_back(request);
+        }
+      }
     }
-    catch (const std::exception &ex) {
-      _out.printError("Error sending packet: " + std::string(ex.what()));
-      requestsGuard.lock();
-      _serialRequests.erase(packetType);
-      requestsGuard.unlock();
-      return;
+
+    for (auto &expiredRequest : expiredRequests) {
+      expiredRequest->response.set_value(std::vector<uint8_t>());
     }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
 
-    std::unique_lock<std::mutex> lock(request->mutex);
-    if (!request->conditionVariable.wait_for(lock, std::chrono::milliseconds(1000), [&] { return request->mutexReady; })) {
+bool IEnOceanInterface::waitForSerialResponse(std::future<std::vector<uint8_t>> &future, const std::vector<uint8_t> &requestPacket, std::vector<uint8_t> &responsePacket) {
+  try {
+    responsePacket.clear();
+    if (!future.valid()) return false;
+    //Radio telegrams might wait in the TX scheduler for a while, so the timeout only starts when the command is written
+    //(see expireSerialRequests()). The overall limit is a safety net.
+    int64_t startTime = BaseLib::HelperFunctions::getTime();
+    while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+      if (BaseLib::HelperFunctions::getTime() - startTime > _maxSerialCommandTime) break;
+      std::vector<std::shared_ptr<SerialRequest>> expiredRequests;
+      {
+        std::lock_guard<std::mutex> requestsGuard(_serialRequestsMutex);
+        expireSerialRequests(BaseLib::HelperFunctions::getTime(), expiredRequests);
+      }
+      if (!expiredRequests.empty()) _serialRequestsConditionVariable.notify_all();
+      for (auto &expiredRequest : expiredRequests) {
+        expiredRequest->response.set_value(std::vector<uint8_t>());
+      }
+    }
+    if (future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) responsePacket = future.get();
+    if (responsePacket.empty()) {
       _out.printError("Error: No serial ACK received to packet: " + BaseLib::HelperFunctions::getHexString(requestPacket));
+      return false;
     }
-    responsePacket = request->response;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void IEnOceanInterface::getResponse(uint8_t packetType, std::vector<uint8_t> &requestPacket, std::vector<uint8_t> &responsePacket) {
+  try {
+    responsePacket.clear();
+    if (_stopped) return;
 
-    requestsGuard.lock();
-    _serialRequests.erase(packetType);
-    requestsGuard.unlock();
+    auto future = queueSerialCommand(packetType, requestPacket);
+    waitForSerialResponse(future, requestPacket, responsePacket);
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -70,17 +166,36 @@ void IEnOceanInterface::getResponse(uint8_t packetType, std::vector<uint8_t> &re
 bool IEnOceanInterface::checkForSerialRequest(const std::vector<uint8_t> &packet) {
   try {
     uint8_t packetType = packet.at(4);
-    std::unique_lock<std::mutex> requestsGuard(_serialRequestsMutex);
-    auto requestIterator = _serialRequests.find(packetType);
-    if (requestIterator != _serialRequests.end()) {
-      auto request = requestIterator->second;
-      requestsGuard.unlock();
-      request->response = packet;
-      {
-        std::lock_guard<std::mutex> lock(request->mutex);
-        request->mutexReady = true;
+    std::shared_ptr<SerialRequest> request;
+    std::vector<std::shared_ptr<SerialRequest>> expiredRequests;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_serialRequestsMutex);
+      expireSerialRequests(BaseLib::HelperFunctions::getTime(), expiredRequests);
+      //Responses carry no reference to their command, so they are matched to the oldest outstanding command.
+      for (auto requestIterator = _serialRequests.begin(); requestIterator != _serialRequests.end(); ++requestIterator) {
+        if ((*requestIterator)->packetType == packetType) {
+          request = *requestIterator;
+          _serialRequests.erase(requestIterator);
+          break;
+        }
+      }
+    }
+    if (request || !expiredRequests.empty()) _serialRequestsConditionVariable.notify_all();
+
+    for (auto &expiredRequest : expiredRequests) {
+      expiredRequest->response.set_value(std::vector<uint8_t>());
+    }
+
+    if (request) {
+      if (request->callback) {
+        try {
+          request->callback(packet);
+        }
+        catch (const std::exception &ex) {
+          _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+        }
       }
-      request->conditionVariable.notify_all();
+      request->response.set_value(packet);
       return true;
     }
   }
@@ -90,42 +205,68 @@ bool IEnOceanInterface::checkForSerialRequest(const std::vector<uint8_t> &packet
   return false;
 }
 
+void IEnOceanInterface::addEnOceanRequest(const std::shared_ptr<EnOceanRequest> &request) {
+  try {
+    std::lock_guard<std::mutex> requestsGuard(_enoceanRequestsMutex);
+    request->id = _packetId++;
+    for (auto key : request->keys) {
+      _enoceanRequests[key].push_back(request);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void IEnOceanInterface::removeEnOceanRequest(const std::shared_ptr<EnOceanRequest> &request) {
+  try {
+    std::lock_guard<std::mutex> requestsGuard(_enoceanRequestsMutex);
+    for (auto key : request->keys) {
+      auto requestsIterator = _enoceanRequests.find(key);
+      if (requestsIterator == _enoceanRequests.end()) continue;
+      auto &requests = requestsIterator->second;
+      requests.erase(std::remove(requests.begin(), requests.end(), request), requests.end());
+      if (requests.empty()) _enoceanRequests.erase(requestsIterator);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
 bool IEnOceanInterface::checkForEnOceanRequest(PEnOceanPacket &packet) {
   try {
-    std::unique_lock<std::mutex> requestsGuard(_enoceanRequestsMutex);
-    auto requestIterator = _enoceanRequests.find(packet->senderAddress());
-    if (requestIterator != _enoceanRequests.end()) {
-      for (auto &element : requestIterator->second) {
-        auto request = element.second;
-        if (request->filterType == EnOceanRequestFilterType::remoteManagementFunction) {
-          bool found = false;
-          for (auto &filterData : request->filterData) {
-            if (filterData.size() >= 2) {
-              uint16_t function = (uint16_t)((uint16_t)filterData[0] << 8u) | filterData[1];
-              if (packet->getRemoteManagementFunction() != function) continue;
-              if (request->filterData.size() >= 4) {
-                uint16_t manufacturer = (uint16_t)((uint16_t)filterData[2] << 8u) | filterData[3];
-                if (packet->getRemoteManagementManufacturer() != manufacturer) continue;
-              }
-              found = true;
-            }
-            if (found) break;
-          }
-          if (!found) continue;
-        }
-        requestsGuard.unlock();
+    std::shared_ptr<EnOceanRequest> request;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_enoceanRequestsMutex);
+      if (_enoceanRequests.empty()) return false;
+
+      uint32_t senderAddress = packet->senderAddress();
+      uint16_t function = packet->getRemoteManagementFunction();
+      const std::array<uint64_t, 3> keys{getEnOceanRequestKey(senderAddress, _anyRequestKeyPart, _anyRequestKeyPart),
+                                         getEnOceanRequestKey(senderAddress, function, _anyRequestKeyPart),
+                                         getEnOceanRequestKey(senderAddress, function, packet->getRemoteManagementManufacturer())};
+      for (auto key : keys) {
+        auto requestsIterator = _enoceanRequests.find(key);
+        if (requestsIterator == _enoceanRequests.end() || requestsIterator->second.empty()) continue;
+        auto &candidate = requestsIterator->second.front();
+        if (!request || candidate->id < request->id) request = candidate;
+      }
+    }
+    if (!request) return false;
 
-        _out.printInfo("Info: Response packet received (RSSI: " + std::to_string(packet->getRssi()) + " dBm): " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
+    Log::info(_out, [&]() { return "Info: Response packet received (RSSI: " + std::to_string(packet->getRssi()) + " dBm): " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
 
+    {
+      std::lock_guard<std::mutex> lock(request->mutex);
+      //The request stays registered until the sender removes it, so repeated copies of the response are swallowed, too.
+      if (!request->mutexReady) {
         request->response = packet;
-        {
-          std::lock_guard<std::mutex> lock(request->mutex);
-          request->mutexReady = true;
-        }
-        request->conditionVariable.notify_all();
-        return true;
+        request->mutexReady = true;
       }
     }
+    request->conditionVariable.notify_all();
+    return true;
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -135,19 +276,7 @@ bool IEnOceanInterface::checkForEnOceanRequest(PEnOceanPacket &packet) {
 
 void IEnOceanInterface::addCrc8(std::vector<uint8_t> &packet) {
   try {
-    if (packet.size() < 6) return;
-
-    uint8_t crc8 = 0;
-    for (int32_t i = 1; i < 5; i++) {
-      crc8 = _crc8Table[crc8 ^ (uint8_t)packet[i]];
-    }
-    packet[5] = crc8;
-
-    crc8 = 0;
-    for (uint32_t i = 6; i < packet.size() - 1; i++) {
-      crc8 = _crc8Table[crc8 ^ (uint8_t)packet[i]];
-    }
-    packet.back() = crc8;
+    Esp3Codec::finalize(packet);
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -158,26 +287,12 @@ void IEnOceanInterface::raisePacketReceived(std::shared_ptr<BaseLib::Systems::Pa
   try {
     PEnOceanPacket myPacket(std::dynamic_pointer_cast<EnOceanPacket>(packet));
     if (!myPacket) return;
+    myPacket->setInterfaceHandle(_handle);
 
     if (myPacket->senderAddress() != (int32_t)_baseAddress) {
-      std::lock_guard<std::mutex> rssiGuard(_rssiMutex);
-      if (_rssi.size() > 10000 || _wildcardRssi.size() > 10000) {
-        _out.printWarning("Warning: More than 10000 RSSI values are stored. Clearing them...");
-        _rssi.clear();
-        _wildcardRssi.clear();
-      }
-
-      auto rssiIterator = _rssi.find(myPacket->senderAddress());
-      if (rssiIterator == _rssi.end()) rssiIterator = _rssi.emplace(myPacket->senderAddress(), DeviceInfo()).first;
-      rssiIterator->second.rssi = myPacket->getRssi();
-      //rssiIterator->second.packetReceivedTimes.push(myPacket->timeReceived());
-      //while(rssiIterator->second.packetReceivedTimes.size() > 5) rssiIterator->second.packetReceivedTimes.pop();
-
-      rssiIterator = _wildcardRssi.find(myPacket->senderAddress());
-      if (rssiIterator == _wildcardRssi.end()) rssiIterator = _wildcardRssi.emplace(myPacket->senderAddress() & 0xFFFFFF80, DeviceInfo()).first;
-      rssiIterator->second.rssi = myPacket->getRssi();
-      //rssiIterator->second.packetReceivedTimes.push(myPacket->timeReceived());
-      //while(rssiIterator->second.packetReceivedTimes.size() > 5) rssiIterator->second.packetReceivedTimes.pop();
+      auto time = BaseLib::HelperFunctions::getTime();
+      _rssi.set(myPacket->senderAddress(), myPacket->getRssi(), time);
+      _wildcardRssi.set(myPacket->senderAddress() & 0xFFFFFF80u, myPacket->getRssi(), time);
     }
 
     BaseLib::Systems::IPhysicalInterface::raisePacketReceived(packet);
@@ -189,14 +304,9 @@ void IEnOceanInterface::raisePacketReceived(std::shared_ptr<BaseLib::Systems::Pa
 
 int32_t IEnOceanInterface::getRssi(int32_t address, bool wildcardPeer) {
   try {
-    std::lock_guard<std::mutex> rssiGuard(_rssiMutex);
-    if (wildcardPeer) {
-      auto rssiIterator = _wildcardRssi.find(address & 0xFFFFFF80);
-      if (rssiIterator != _wildcardRssi.end()) return rssiIterator->second.rssi;
-    } else {
-      auto rssiIterator = _rssi.find(address);
-      if (rssiIterator != _rssi.end()) return rssiIterator->second.rssi;
-    }
+    auto time = BaseLib::HelperFunctions::getTime();
+    if (wildcardPeer) return _wildcardRssi.get((uint32_t)address & 0xFFFFFF80u, time);
+    else return _rssi.get((uint32_t)address, time);
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -204,31 +314,46 @@ int32_t IEnOceanInterface::getRssi(int32_t address, bool wildcardPeer) {
   return 0;
 }
 
-void IEnOceanInterface::decrementRssi(uint32_t address, bool wildcardPeer) {
+IEnOceanInterface::DutyCycleInfo IEnOceanInterface::getDutyCycleInfo(bool resync) {
   try {
-    std::lock_guard<std::mutex> rssiGuard(_rssiMutex);
-    if (wildcardPeer) {
-      auto rssiIterator = _wildcardRssi.find(address & 0xFFFFFF80u);
-      if (rssiIterator != _wildcardRssi.end()) rssiIterator->second.rssi -= 5;
-    } else {
-      auto rssiIterator = _rssi.find(address);
-      if (rssiIterator != _rssi.end()) rssiIterator->second.rssi -= 5;
+    auto time = BaseLib::HelperFunctions::getTime();
+    if (resync || time - _lastDutyCycleSync >= 600000) {
+      _lastDutyCycleSync = time;
+      auto moduleInfo = readDutyCycleInfo();
+      if (moduleInfo.valid) _dutyCycleEstimator.sync(moduleInfo.dutyCycleUsed, time);
     }
+
+    DutyCycleInfo info;
+    info.valid = true;
+    info.dutyCycleUsed = _dutyCycleEstimator.getDutyCycleUsed(time);
+    info.slotPeriod = DutyCycleEstimator::bucketDuration / 1000;
+    info.timeLeftInSlot = _dutyCycleEstimator.getTimeUntilRelease(time);
+    return info;
+  } catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
-  catch (const std::exception &ex) {
+  return DutyCycleInfo();
+}
+
+void IEnOceanInterface::startTxScheduler() {
+  try {
+    auto dutyCycleSetting = Gd::family->getFamilySetting("txDutyCycle");
+    double dutyCycle = dutyCycleSetting && dutyCycleSetting->integerValue > 0 ? (double)dutyCycleSetting->integerValue : 1.0;
+    auto queueSizeSetting = Gd::family->getFamilySetting("txQueueSize");
+    uint32_t queueSize = queueSizeSetting && queueSizeSetting->integerValue > 0 ? (uint32_t)queueSizeSetting->integerValue : 1000;
+
+    _dutyCycleEstimator.setDutyCycle(dutyCycle);
+    _txScheduler.setLaneSize(queueSize);
+    _lastDutyCycleSync = 0;
+    _txScheduler.start();
+  } catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void IEnOceanInterface::rawSend(std::vector<uint8_t> &packet) {
+void IEnOceanInterface::stopTxScheduler() {
   try {
-    if (packet.size() > 7 && packet.at(6) == 0xD1) return; //Send MSC packets immediately (e. g. firmware update)
-    std::lock_guard<std::mutex> rawSendGuard(_rawSendMutex);
-    auto time = BaseLib::HelperFunctions::getTime();
-    if (time - _lastRawPacketSent < 80) {
-      std::this_thread::sleep_for(std::chrono::milliseconds((_lastRawPacketSent + BaseLib::HelperFunctions::getRandomNumber(80, 150) - time)));
-    }
-    _lastRawPacketSent = BaseLib::HelperFunctions::getTime();
+    _txScheduler.stop();
   } catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
@@ -272,43 +397,37 @@ PEnOceanPacket IEnOceanInterface::sendAndReceivePacket(const std::vector<PEnOcea
     if (_stopped || packets.empty() || !packets.at(0)) return {};
 
     std::shared_ptr<EnOceanRequest> request = std::make_shared<EnOceanRequest>();
-    request->filterType = filter_type;
-    request->filterData = filter_data;
-
-    std::unique_lock<std::mutex> requestsGuard(_enoceanRequestsMutex);
-    uint32_t packetId = _packetId++;
-    _enoceanRequests[device_enocean_id][packetId] = request;
-    requestsGuard.unlock();
-
-    std::unique_lock<std::mutex> lock(request->mutex);
+    if (filter_type == EnOceanRequestFilterType::remoteManagementFunction) {
+      request->keys.reserve(filter_data.size());
+      for (auto &filterData : filter_data) {
+        if (filterData.size() < 2) continue;
+        uint16_t function = (uint16_t)((uint16_t)filterData[0] << 8u) | filterData[1];
+        uint16_t manufacturer = filterData.size() >= 4 ? (uint16_t)((uint16_t)filterData[2] << 8u) | filterData[3] : _anyRequestKeyPart;
+        request->keys.push_back(getEnOceanRequestKey(device_enocean_id, function, manufacturer));
+      }
+      std::sort(request->keys.begin(), request->keys.end());
+      request->keys.erase(std::unique(request->keys.begin(), request->keys.end()), request->keys.end());
+    } else request->keys.push_back(getEnOceanRequestKey(device_enocean_id, _anyRequestKeyPart, _anyRequestKeyPart));
+    addEnOceanRequest(request);
 
     for (uint32_t i = 0; i < retries + 1; i++) {
       if (!sendEnoceanPacket(packets)) {
-        requestsGuard.lock();
-        auto requestsIterator = _enoceanRequests.find(device_enocean_id);
-        if (requestsIterator != _enoceanRequests.end()) {
-          requestsIterator->second.erase(packetId);
-          if (requestsIterator->second.empty()) _enoceanRequests.erase(device_enocean_id);
-        }
-        requestsGuard.unlock();
+        removeEnOceanRequest(request);
         return {};
       }
 
+      //Not locked while sending. The listening thread would block on the mutex when a response arrives early and
+      //couldn't deliver serial responses anymore.
+      std::unique_lock<std::mutex> lock(request->mutex);
       if (!request->conditionVariable.wait_for(lock, std::chrono::milliseconds(timeout), [&] { return request->mutexReady; })) {
-        if (i < retries) _out.printInfo("Info: No EnOcean response received to packet: " + BaseLib::HelperFunctions::getHexString(packets.at(0)->getBinary()) + ". Retrying...");
+        if (i < retries) Log::info(_out, [&]() { return "Info: No EnOcean response received to packet: " + BaseLib::HelperFunctions::getHexString(packets.at(0)->getBinary()) + ". Retrying..."; });
         else _out.printError("Error: No EnOcean response received to packet: " + BaseLib::HelperFunctions::getHexString(packets.at(0)->getBinary()));
       }
 
       if (request->response) break;
     }
 
-    requestsGuard.lock();
-    auto requestsIterator = _enoceanRequests.find(device_enocean_id);
-    if (requestsIterator != _enoceanRequests.end()) {
-      requestsIterator->second.erase(packetId);
-      if (requestsIterator->second.empty()) _enoceanRequests.erase(device_enocean_id);
-    }
-    requestsGuard.unlock();
+    removeEnOceanRequest(request);
 
     return request->response;
   }
@@ -0,0 +1,56 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "RssiStore.h"
+
+namespace EnOcean {
+
+RssiStore::RssiStore(uint32_t capacity) {
+  _shardCapacity = capacity / shardCount;
+  if (_shardCapacity == 0) _shardCapacity = 1;
+}
+
+RssiStore::Shard &RssiStore::getShard(uint32_t address) {
+  //Consecutive addresses (e. g. the channels of one device) should land in different shards.
+  uint32_t hash = address * 0x9E3779B1u;
+  return _shards[hash >> 28u];
+}
+
+void RssiStore::set(uint32_t address, int32_t rssi, int64_t time) {
+  auto &shard = getShard(address);
+  std::lock_guard<std::mutex> shardGuard(shard.mutex);
+  auto entryIterator = shard.entries.find(address);
+  if (entryIterator == shard.entries.end()) {
+    if (shard.entries.size() >= _shardCapacity) {
+      shard.entries.erase(shard.lru.back());
+      shard.lru.pop_back();
+    }
+    shard.lru.push_front(address);
+    entryIterator = shard.entries.emplace(address, Entry()).first;
+    entryIterator->second.lruPosition = shard.lru.begin();
+  } else shard.lru.splice(shard.lru.begin(), shard.lru, entryIterator->second.lruPosition);
+  entryIterator->second.rssi = rssi;
+  entryIterator->second.time = time;
+}
+
+int32_t RssiStore::get(uint32_t address, int64_t time) {
+  auto &shard = getShard(address);
+  std::lock_guard<std::mutex> shardGuard(shard.mutex);
+  auto entryIterator = shard.entries.find(address);
+  if (entryIterator == shard.entries.end()) return 0;
+  shard.lru.splice(shard.lru.begin(), shard.lru, entryIterator->second.lruPosition);
+  auto &entry = entryIterator->second;
+  int64_t decay = time > entry.time ? (time - entry.time) / _decayInterval : 0;
+  int64_t rssi = entry.rssi - decay;
+  return rssi < -127 ? -127 : (int32_t)rssi;
+}
+
+size_t RssiStore::size() {
+  size_t size = 0;
+  for (auto &shard : _shards) {
+    std::lock_guard<std::mutex> shardGuard(shard.mutex);
+    size += shard.entries.size();
+  }
+  return size;
+}
+
+}
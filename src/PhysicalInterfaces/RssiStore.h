@@ -0,0 +1,67 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef RSSISTORE_H_
+#define RSSISTORE_H_
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace EnOcean {
+
+/**
+ * Last RSSI of each sender received by one interface.
+ *
+ * The store is split into shards with their own lock, so interfaces and dispatch workers rarely wait for each other.
+ * Memory is bounded: When a shard is full, the least recently used address is evicted. Reads count as use, so the
+ * addresses of peers (which are read during roaming) stay while foreign senders are evicted first.
+ *
+ * The RSSI decays over time, so an interface which doesn't receive a sender anymore slowly loses it to interfaces
+ * that still do.
+ */
+class RssiStore {
+ public:
+  static constexpr uint32_t shardCount = 16;
+
+  /**
+   * @param capacity Maximum number of addresses.
+   */
+  explicit RssiStore(uint32_t capacity = 10000);
+
+  void set(uint32_t address, int32_t rssi, int64_t time);
+
+  /**
+   * @return The decayed RSSI or 0 when nothing was received from the address.
+   */
+  int32_t get(uint32_t address, int64_t time);
+  size_t size();
+ private:
+  /**
+   * The RSSI decays by 1 dB per this many milliseconds (i. e. 0.5 dB per minute).
+   */
+  static constexpr int64_t _decayInterval = 120000;
+
+  struct Entry {
+    int32_t rssi = 0;
+    int64_t time = 0;
+    std::list<uint32_t>::iterator lruPosition;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, Entry> entries;
+    //Most recently used first
+    std::list<uint32_t> lru;
+  };
+
+  uint32_t _shardCapacity = 625;
+  std::array<Shard, shardCount> _shards;
+
+  Shard &getShard(uint32_t address);
+};
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "TxScheduler.h"
+#include "../Gd.h"
+
+namespace EnOcean {
+
+TxScheduler::TxScheduler(BaseLib::Output &out, DutyCycleEstimator &dutyCycleEstimator) : _out(out), _dutyCycleEstimator(dutyCycleEstimator) {
+}
+
+TxScheduler::~TxScheduler() {
+  stop();
+}
+
+void TxScheduler::setLaneSize(uint32_t laneSize) {
+  try {
+    std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+    _laneSize = laneSize > 0 ? laneSize : 1000;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void TxScheduler::start() {
+  try {
+    std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+    if (_running) return;
+    _stop = false;
+    _running = true;
+    Gd::bl->threadManager.start(_thread, true, &TxScheduler::run, this);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void TxScheduler::stop() {
+  try {
+    {
+      std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+      if (!_running) return;
+      _stop = true;
+    }
+    _lanesConditionVariable.notify_all();
+    Gd::bl->threadManager.join(_thread);
+    std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+    _running = false;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool TxScheduler::enqueue(Priority priority, std::vector<uint8_t> frame, TransmitFunction transmit) {
+  try {
+    {
+      std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+      if (!_running || _stop) return false;
+      auto &lane = _lanes.at((uint32_t)priority);
+      if (lane.transmissions.size() >= _laneSize) {
+        lane.dropped++;
+        return false;
+      }
+      Transmission transmission;
+      transmission.airtime = getAirtime(frame);
+      transmission.enqueueTime = BaseLib::HelperFunctions::getTime();
+      transmission.frame = std::move(frame);
+      transmission.transmit = std::move(transmit);
+      lane.transmissions.push_back(std::move(transmission));
+    }
+    _lanesConditionVariable.notify_one();
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+TxScheduler::Statistics TxScheduler::getStatistics() {
+  Statistics statistics;
+  try {
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    statistics.remainingAirtime = _dutyCycleEstimator.getRemainingAirtime(time);
+    statistics.budget = _dutyCycleEstimator.getBudget();
+    std::lock_guard<std::mutex> lanesGuard(_lanesMutex);
+    for (uint32_t i = 0; i < priorityCount; i++) {
+      auto &lane = _lanes.at(i);
+      auto &laneStatistics = statistics.lanes.at(i);
+      laneStatistics.queued = lane.transmissions.size();
+      laneStatistics.sent = lane.sent;
+      laneStatistics.dropped = lane.dropped;
+      laneStatistics.averageWaitTime = lane.sent > 0 ? lane.totalWaitTime / (int64_t)lane.sent : 0;
+      laneStatistics.maxWaitTime = lane.maxWaitTime;
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return statistics;
+}
+
+TxScheduler::Priority TxScheduler::getPriority(const std::vector<uint8_t> &frame) {
+  if (frame.size() < 7) return Priority::interactive;
+  uint8_t rorg = frame[6];
+  if (rorg == 0xD1) return Priority::firmware;
+  if (rorg == 0xC5 || rorg == 0x35) return Priority::configuration; //REMAN and secure teach-in
+  return Priority::interactive;
+}
+
+uint32_t TxScheduler::getAirtime(const std::vector<uint8_t> &frame) {
+  if (frame.size() < 6) return 0;
+  uint32_t dataSize = ((uint32_t)frame[1] << 8u) | frame[2];
+  uint32_t optionalDataSize = frame[3];
+  if (frame.size() < 6 + dataSize + optionalDataSize) return 0;
+  const uint8_t *optionalData = frame.data() + 6 + dataSize;
+
+  //ERP1 telegram: RORG, data, sender ID and status from the ESP3 frame, plus the CRC. Addressed telegrams are
+  //encapsulated (ADT), which adds the RORG 0xA6 and the destination ID.
+  uint32_t telegramSize = dataSize + 1;
+  if (optionalDataSize >= 5) {
+    uint32_t destination = ((uint32_t)optionalData[1] << 24u) | ((uint32_t)optionalData[2] << 16u) | ((uint32_t)optionalData[3] << 8u) | optionalData[4];
+    if (destination != 0xFFFFFFFF) telegramSize += 5;
+  }
+  uint32_t subtelegrams = optionalDataSize >= 1 && optionalData[0] > 0 && optionalData[0] <= 3 ? optionalData[0] : 3;
+
+  //125 kbit/s, 8 µs per bit. Preamble (8 bits), start of frame (4 bits), 12 bits per byte and end of frame (4 bits).
+  return subtelegrams * (16 + telegramSize * 12) * 8;
+}
+
+void TxScheduler::run() {
+  try {
+    std::unique_lock<std::mutex> lanesGuard(_lanesMutex);
+    while (!_stop) {
+      uint32_t priority = 0;
+      for (; priority < priorityCount; priority++) {
+        if (!_lanes.at(priority).transmissions.empty()) break;
+      }
+      if (priority == priorityCount) {
+        _lanesConditionVariable.wait(lanesGuard, [&] { return _stop || !_lanes[0].transmissions.empty() || !_lanes[1].transmissions.empty() || !_lanes[2].transmissions.empty(); });
+        continue;
+      }
+
+      auto &lane = _lanes.at(priority);
+      int64_t time = BaseLib::HelperFunctions::getTime();
+
+      int64_t budget = _dutyCycleEstimator.getBudget();
+      int64_t requiredAirtime = lane.transmissions.front().airtime;
+      if (priority != (uint32_t)Priority::interactive) requiredAirtime += budget / 10;
+      if (requiredAirtime > budget) requiredAirtime = budget;
+      int64_t waitTime = 0;
+      if (_dutyCycleEstimator.getRemainingAirtime(time) < requiredAirtime) {
+        //Airtime is released when the oldest minute leaves the one hour window. Check again at least every second, as
+        //the estimate is also changed by synchronizing with the module.
+        waitTime = (int64_t)_dutyCycleEstimator.getTimeUntilRelease(time) * 1000;
+        if (waitTime <= 0 || waitTime > 1000) waitTime = 1000;
+      }
+      //Keep a random gap between telegrams, so repeaters and other senders get a chance. Firmware blocks are sent
+      //without gap.
+      if (priority != (uint32_t)Priority::firmware && time - _lastTransmission < 80 && _lastTransmission + _nextGap - time > waitTime) {
+        waitTime = _lastTransmission + _nextGap - time;
+      }
+      if (waitTime > 0) {
+        //Wakes up early when a new telegram is queued, which might have a higher priority.
+        _lanesConditionVariable.wait_for(lanesGuard, std::chrono::milliseconds(waitTime));
+        continue;
+      }
+
+      Transmission transmission = std::move(lane.transmissions.front());
+      lane.transmissions.pop_front();
+      int64_t queueTime = time - transmission.enqueueTime;
+      lane.sent++;
+      lane.totalWaitTime += queueTime;
+      if (queueTime > lane.maxWaitTime) lane.maxWaitTime = queueTime;
+      if (priority != (uint32_t)Priority::firmware) {
+        _lastTransmission = time;
+        _nextGap = BaseLib::HelperFunctions::getRandomNumber(80, 150);
+      }
+
+      lanesGuard.unlock();
+      try {
+        transmission.transmit(transmission.frame, false);
+      }
+      catch (const std::exception &ex) {
+        _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+      }
+      lanesGuard.lock();
+    }
+
+    std::vector<Transmission> droppedTransmissions;
+    for (auto &lane : _lanes) {
+      lane.dropped += lane.transmissions.size();
+      for (auto &transmission : lane.transmissions) {
+        droppedTransmissions.push_back(std::move(transmission));
+      }
+      lane.transmissions.clear();
+    }
+    lanesGuard.unlock();
+
+    for (auto &transmission : droppedTransmissions) {
+      transmission.transmit(transmission.frame, true);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+}
@@ -0,0 +1,129 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef TXSCHEDULER_H_
+#define TXSCHEDULER_H_
+
+#include "DutyCycleEstimator.h"
+
+#include <homegear-base/BaseLib.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Transmit scheduler of one interface.
+ *
+ * Radio telegrams are queued in one lane per priority and written by the scheduler thread, so callers never block on
+ * the radio. Telegrams are sent as long as the DutyCycleEstimator of the interface has airtime left in the duty cycle
+ * budget of the last hour (1 % by default, i. e. 36 s per hour). Configuration and firmware telegrams leave a tenth of
+ * the budget to interactive telegrams, so a setValue is not delayed by a running REMAN session or firmware update.
+ * Like rawSend did before, all telegrams except firmware blocks keep a random gap of 80 to 150 ms to the previous one,
+ * so repeaters and other senders get a chance. The scheduler thread waits for the gap, callers don't.
+ */
+class TxScheduler {
+ public:
+  enum class Priority : uint32_t {
+    interactive = 0,
+    configuration = 1,
+    firmware = 2
+  };
+  static constexpr uint32_t priorityCount = 3;
+
+  struct LaneStatistics {
+    size_t queued = 0;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    int64_t averageWaitTime = 0;
+    int64_t maxWaitTime = 0;
+  };
+
+  struct Statistics {
+    std::array<LaneStatistics, priorityCount> lanes;
+    /**
+     * Remaining airtime and airtime budget of one hour in microseconds.
+     */
+    int64_t remainingAirtime = 0;
+    int64_t budget = 0;
+  };
+
+  /**
+   * Called by the scheduler thread when the telegram is due. "dropped" is true when the telegram is discarded
+   * instead, e. g. because the scheduler was stopped.
+   */
+  typedef std::function<void(std::vector<uint8_t> &frame, bool dropped)> TransmitFunction;
+
+  /**
+   * @param dutyCycleEstimator Provides the remaining airtime. Transmissions have to be added to it by the
+   * TransmitFunction.
+   */
+  TxScheduler(BaseLib::Output &out, DutyCycleEstimator &dutyCycleEstimator);
+  ~TxScheduler();
+
+  /**
+   * @param laneSize Maximum number of queued telegrams per lane.
+   */
+  void setLaneSize(uint32_t laneSize);
+  void start();
+  void stop();
+
+  /**
+   * Queues a telegram. Never blocks.
+   *
+   * @return false when the lane is full or the scheduler is not running. "transmit" is not called then.
+   */
+  bool enqueue(Priority priority, std::vector<uint8_t> frame, TransmitFunction transmit);
+  Statistics getStatistics();
+
+  /**
+   * Returns the lane of an ESP3 RADIO_ERP1 frame based on its RORG.
+   */
+  static Priority getPriority(const std::vector<uint8_t> &frame);
+
+  /**
+   * Returns the airtime of an ESP3 RADIO_ERP1 frame including all subtelegrams in microseconds.
+   */
+  static uint32_t getAirtime(const std::vector<uint8_t> &frame);
+ private:
+  struct Transmission {
+    std::vector<uint8_t> frame;
+    uint32_t airtime = 0;
+    int64_t enqueueTime = 0;
+    TransmitFunction transmit;
+  };
+
+  struct Lane {
+    std::deque<Transmission> transmissions;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    int64_t totalWaitTime = 0;
+    int64_t maxWaitTime = 0;
+  };
+
+  BaseLib::Output &_out;
+  DutyCycleEstimator &_dutyCycleEstimator;
+
+  std::mutex _lanesMutex;
+  std::condition_variable _lanesConditionVariable;
+  std::array<Lane, priorityCount> _lanes;
+  bool _running = false;
+  bool _stop = false;
+  std::thread _thread;
+
+  uint32_t _laneSize = 1000;
+  int64_t _lastTransmission = 0;
+  int64_t _nextGap = 0;
+
+  void run();
+};
+
+}
+
+#endif
@@ -2,6 +2,11 @@
 
 #include "../Gd.h"
 #include "Usb300.h"
+#include "Esp3Framer.h"
+#include "../Log.h"
+
+#include <poll.h>
+#include <unistd.h>
 
 namespace EnOcean {
 
@@ -55,6 +60,7 @@ void Usb300::startListening() {
     }
     if (_settings->listenThreadPriority > -1) _bl->threadManager.start(_listenThread, true, _settings->listenThreadPriority, _settings->listenThreadPolicy, &Usb300::listen, this);
     else _bl->threadManager.start(_listenThread, true, &Usb300::listen, this);
+    startTxScheduler();
     IPhysicalInterface::startListening();
 
     init();
@@ -66,6 +72,7 @@ void Usb300::startListening() {
 
 void Usb300::stopListening() {
   try {
+    stopTxScheduler();
     _stopCallbackThread = true;
     _bl->threadManager.join(_listenThread);
     _stopped = true;
@@ -125,7 +132,7 @@ int32_t Usb300::setBaseAddress(uint32_t value) {
   return -1;
 }
 
-IEnOceanInterface::DutyCycleInfo Usb300::getDutyCycleInfo() {
+IEnOceanInterface::DutyCycleInfo Usb300::readDutyCycleInfo() {
   try {
     std::vector<uint8_t> response;
     for (int32_t i = 0; i < 10; i++) {
@@ -140,6 +147,7 @@ IEnOceanInterface::DutyCycleInfo Usb300::getDutyCycleInfo() {
       }
 
       DutyCycleInfo info;
+      info.valid = true;
       info.dutyCycleUsed = response[7];
       info.slotPeriod = (((uint32_t)response[9]) << 8) | response[10];
       info.timeLeftInSlot = (((uint32_t)response[11]) << 8) | response[12];
@@ -239,10 +247,7 @@ void Usb300::listen() {
   try {
     std::vector<uint8_t> data;
     data.reserve(100);
-    char byte = 0;
-    int32_t result = 0;
-    uint32_t size = 0;
-    uint8_t crc8 = 0;
+    Esp3Framer framer;
 
     while (!_stopCallbackThread) {
       try {
@@ -250,56 +255,59 @@ void Usb300::listen() {
           if (_stopCallbackThread) return;
           if (_stopped) _out.printWarning("Warning: Connection to device closed. Trying to reconnect...");
           _serial->closeDevice();
+          framer.clear();
           std::this_thread::sleep_for(std::chrono::milliseconds(10000));
           reconnect();
           continue;
         }
 
-        result = _serial->readChar(byte, 100000);
+        auto fileDescriptor = _serial->fileDescriptor();
+        if (!fileDescriptor || fileDescriptor->descriptor == -1) {
+          _stopped = true;
+          continue;
+        }
+
+        pollfd pollInfo{fileDescriptor->descriptor, (short)(POLLIN | POLLERR | POLLHUP), 0};
+        int32_t result = poll(&pollInfo, 1, 100);
         if (result == -1) {
+          if (errno == EINTR) continue;
           _out.printError("Error reading from serial device.");
           _stopped = true;
-          size = 0;
-          data.clear();
+          framer.clear();
           continue;
-        } else if (result == 1) {
-          size = 0;
-          data.clear();
+        } else if (result == 0) {
+          //Timeout. Discard incomplete packets.
+          framer.clear();
+          continue;
+        } else if (pollInfo.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+          _out.printError("Error reading from serial device.");
+          _stopped = true;
+          framer.clear();
           continue;
         }
 
-        if (data.empty() && byte != 0x55) continue;
-        data.push_back((uint8_t)byte);
+        //Read everything that is available in one go
+        auto region = framer.writeRegion();
+        ssize_t bytesRead = read(fileDescriptor->descriptor, region.first, region.second);
+        if (bytesRead <= 0) {
+          if (bytesRead == -1 && (errno == EAGAIN || errno == EINTR)) continue;
+          _out.printError("Error reading from serial device.");
+          _stopped = true;
+          framer.clear();
+          continue;
+        }
+        framer.commit((size_t)bytesRead);
 
-        if (size == 0 && data.size() == 6) {
-          crc8 = 0;
-          for (int32_t i = 1; i < 5; i++) {
-            crc8 = _crc8Table[crc8 ^ (uint8_t)data[i]];
-          }
-          if (crc8 != data[5]) {
-            _out.printError("Error: CRC (0x" + BaseLib::HelperFunctions::getHexString(crc8, 2) + ") failed for header: " + BaseLib::HelperFunctions::getHexString(data));
-            size = 0;
-            data.clear();
+        Esp3Framer::Result frameResult;
+        while ((frameResult = framer.nextFrame(data)) != Esp3Framer::Result::needMoreData) {
+          if (frameResult == Esp3Framer::Result::headerCrcError) {
+            _out.printError("Error: CRC failed for header: " + BaseLib::HelperFunctions::getHexString(data));
             continue;
-          }
-          size = (((uint16_t)data[1] << 8) | data[2]) + data[3];
-          if (size == 0) {
+          } else if (frameResult == Esp3Framer::Result::invalidSize) {
             _out.printError("Error: Header has invalid size information: " + BaseLib::HelperFunctions::getHexString(data));
-            size = 0;
-            data.clear();
             continue;
-          }
-          size += 7;
-        }
-        if (size > 0 && data.size() == size) {
-          crc8 = 0;
-          for (uint32_t i = 6; i < data.size() - 1; i++) {
-            crc8 = _crc8Table[crc8 ^ (uint8_t)data[i]];
-          }
-          if (crc8 != data.back()) {
+          } else if (frameResult == Esp3Framer::Result::dataCrcError) {
             _out.printError("Error: CRC failed for packet: " + BaseLib::HelperFunctions::getHexString(data));
-            size = 0;
-            data.clear();
             continue;
           }
 
@@ -308,8 +316,6 @@ void Usb300::listen() {
           processPacket(data);
 
           _lastPacketReceived = BaseLib::HelperFunctions::getTime();
-          size = 0;
-          data.clear();
         }
       }
       catch (const std::exception &ex) {
@@ -331,13 +337,13 @@ void Usb300::processPacket(std::vector<uint8_t> &data) {
 
     if (checkForSerialRequest(data)) return;
 
-    PEnOceanPacket packet = std::make_shared<EnOceanPacket>(data);
+    PEnOceanPacket packet = _packetPool.get(data);
     if (checkForEnOceanRequest(packet)) return;
     if (packet->getType() == EnOceanPacket::Type::RADIO_ERP1 || packet->getType() == EnOceanPacket::Type::RADIO_ERP2) {
-      if ((packet->senderAddress() & 0xFFFFFF80) == _baseAddress) _out.printInfo("Info: Ignoring packet from myself: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()));
+      if ((packet->senderAddress() & 0xFFFFFF80) == _baseAddress) Log::info(_out, [&]() { return "Info: Ignoring packet from myself: " + BaseLib::HelperFunctions::getHexString(packet->getBinary()); });
       else raisePacketReceived(packet);
     } else {
-      _out.printInfo("Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(data));
+      Log::info(_out, [&]() { return "Info: Not processing packet: " + BaseLib::HelperFunctions::getHexString(data); });
     }
   }
   catch (const std::exception &ex) {
@@ -358,6 +364,10 @@ bool Usb300::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
       }
     }
 
+    //All chunks are written back to back. The responses are collected afterwards, so a multi-chunk packet doesn't cost
+    //one serial round trip per chunk.
+    std::vector<std::pair<std::vector<uint8_t>, std::future<std::vector<uint8_t>>>> pendingResponses;
+    pendingResponses.reserve(packets.size());
     uint32_t i = 0;
     for (auto &packet: packets) {
       i++;
@@ -367,13 +377,19 @@ bool Usb300::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
       addCrc8(data);
 
       if (packet->getRorg() == 0xC5) {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") " + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + " (REMAN function 0x" + BaseLib::HelperFunctions::getHexString(packet->getRemoteManagementFunction(), 3) + ") " + BaseLib::HelperFunctions::getHexString(data); });
       } else {
-        Gd::out.printInfo("Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data));
+        Log::info(Gd::out, [&]() { return "Info: Sending packet " + std::to_string(i) + " of " + std::to_string(packets.size()) + ": " + BaseLib::HelperFunctions::getHexString(data); });
       }
 
+      auto future = queueSerialCommand(0x02, data);
+      pendingResponses.emplace_back(std::move(data), std::move(future));
+    }
+
+    for (auto &pendingResponse : pendingResponses) {
+      auto &data = pendingResponse.first;
       std::vector<uint8_t> response;
-      getResponse(0x02, data, response);
+      waitForSerialResponse(pendingResponse.second, data, response);
       if (response.size() != 8 || (response.size() >= 7 && response[6] != 0)) {
         if (response.size() >= 7 && response[6] != 0) {
           auto statusIterator = _responseStatusCodes.find(response[6]);
@@ -394,7 +410,6 @@ bool Usb300::sendEnoceanPacket(const std::vector<PEnOceanPacket> &packets) {
 
 void Usb300::rawSend(std::vector<uint8_t> &packet) {
   try {
-    IEnOceanInterface::rawSend(packet);
     if (!_serial || !_serial->isOpen()) return;
     _serial->writeData(packet);
   }
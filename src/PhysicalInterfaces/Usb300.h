@@ -21,7 +21,6 @@ class Usb300 : public IEnOceanInterface {
   void setup(int32_t userID, int32_t groupID, bool setPermissions) override;
 
   int32_t setBaseAddress(uint32_t value) override;
-  DutyCycleInfo getDutyCycleInfo() override;
 
   bool isOpen() override { return _serial && _serial->isOpen() && !_stopped; }
 
@@ -35,6 +34,7 @@ class Usb300 : public IEnOceanInterface {
   void reconnect();
   void listen();
   void rawSend(std::vector<uint8_t> &packet) override;
+  DutyCycleInfo readDutyCycleInfo() override;
   void processPacket(std::vector<uint8_t> &data);
 };
 
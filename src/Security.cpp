@@ -5,25 +5,159 @@
 #include "Gd.h"
 
 namespace EnOcean {
-Security::Security(BaseLib::SharedObjects *bl) : _bl(bl) {
+SecurityContext::SecurityContext(const std::vector<uint8_t> &aesKey) : SecurityContext(aesKey, getConfiguredImplementation()) {
+}
+
+SecurityContext::SecurityContext(const std::vector<uint8_t> &aesKey, Aes128::Implementation implementation) {
+  try {
+    if (aesKey.empty()) return;
+    if (implementation != Aes128::Implementation::none && aesKey.size() == 16) {
+      _nativeAes = std::make_unique<Aes128>(aesKey.data(), implementation);
+      if (_nativeAes->isValid()) {
+        std::array<uint8_t, 16> zeroBlock{};
+        _nativeAes->encrypt(_subkey1.data(), zeroBlock.data(), 1);
+        deriveSubkeys();
+        _valid = true;
+        return;
+      }
+      _nativeAes.reset();
+    }
+
+    _aesKey = (uint8_t *)gcry_malloc_secure(aesKey.size());
+    if (!_aesKey) {
+      Gd::out.printError("Error: Could not allocate secure memory for AES key.");
+      return;
+    }
+    _aesKeySize = aesKey.size();
+    std::copy(aesKey.begin(), aesKey.end(), _aesKey);
+
+    auto handle = createHandle();
+    if (!handle) return;
+
+    gcry_error_t result;
+    std::array<uint8_t, 16> zeroBlock{};
+    if ((result = gcry_cipher_encrypt(handle, _subkey1.data(), _subkey1.size(), zeroBlock.data(), zeroBlock.size())) != GPG_ERR_NO_ERROR) {
+      Gd::out.printError("Error encrypting data: " + BaseLib::Security::Gcrypt::getError(result));
+      gcry_cipher_close(handle);
+      return;
+    }
+    _idleHandles.push_back(handle);
+    deriveSubkeys();
+    _valid = true;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+SecurityContext::~SecurityContext() {
+  for (auto handle : _idleHandles) {
+    gcry_cipher_close(handle);
+  }
+  _idleHandles.clear();
+  //gcry_free() of secure memory wipes it.
+  if (_aesKey) gcry_free(_aesKey);
+  _aesKey = nullptr;
+}
+
+Aes128::Implementation SecurityContext::getConfiguredImplementation() {
+  auto backend = Gd::settings.aesBackend();
+  if (backend == SettingsCache::AesBackend::gcrypt) return Aes128::Implementation::none;
+  return Aes128::select(backend == SettingsCache::AesBackend::native);
+}
+
+void SecurityContext::deriveSubkeys() {
+  //Subkeys as in RFC 4493. _subkey1 contains the encrypted zero block.
+  bool useConstRb = (_subkey1[0] & 0x80);
+  leftShift(_subkey1);
+  if (useConstRb) _subkey1[15] ^= (uint8_t)0x87;
+
+  _subkey2 = _subkey1;
+  useConstRb = (_subkey2[0] & 0x80);
+  leftShift(_subkey2);
+  if (useConstRb) _subkey2[15] ^= (uint8_t)0x87;
+}
+
+gcry_cipher_hd_t SecurityContext::createHandle() {
+  gcry_cipher_hd_t handle = nullptr;
   gcry_error_t result;
-  if ((result = gcry_cipher_open(&_encryptHandle, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_ECB, GCRY_CIPHER_SECURE)) != GPG_ERR_NO_ERROR) {
-    _encryptHandle = nullptr;
+  if ((result = gcry_cipher_open(&handle, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_ECB, GCRY_CIPHER_SECURE)) != GPG_ERR_NO_ERROR) {
     Gd::out.printError("Error initializing cypher handle for encryption: " + BaseLib::Security::Gcrypt::getError(result));
-    return;
+    return nullptr;
   }
-  if (!_encryptHandle) {
+  if (!handle) {
     Gd::out.printError("Error cypher handle for encryption is nullptr.");
-    return;
+    return nullptr;
+  }
+
+  if ((result = gcry_cipher_setkey(handle, _aesKey, _aesKeySize)) != GPG_ERR_NO_ERROR) {
+    Gd::out.printError("Error: Could not set key for encryption: " + BaseLib::Security::Gcrypt::getError(result));
+    gcry_cipher_close(handle);
+    return nullptr;
+  }
+
+  return handle;
+}
+
+gcry_cipher_hd_t SecurityContext::acquireHandle() {
+  {
+    std::lock_guard<std::mutex> handlesGuard(_handlesMutex);
+    if (!_idleHandles.empty()) {
+      auto handle = _idleHandles.back();
+      _idleHandles.pop_back();
+      return handle;
+    }
+  }
+  return createHandle();
+}
+
+void SecurityContext::releaseHandle(gcry_cipher_hd_t handle) {
+  {
+    std::lock_guard<std::mutex> handlesGuard(_handlesMutex);
+    if (_idleHandles.size() < _maxIdleHandles) {
+      _idleHandles.push_back(handle);
+      return;
+    }
+  }
+  gcry_cipher_close(handle);
+}
+
+bool SecurityContext::encrypt(uint8_t *out, const uint8_t *in, size_t size) {
+  if (!_valid || size % 16 != 0) return false;
+  if (_nativeAes) {
+    _nativeAes->encrypt(out, in, size / 16);
+    return true;
+  }
+  auto handle = acquireHandle();
+  if (!handle) return false;
+  gcry_error_t result;
+  if ((result = gcry_cipher_encrypt(handle, out, size, in, size)) != GPG_ERR_NO_ERROR) {
+    Gd::out.printError("Error encrypting data: " + BaseLib::Security::Gcrypt::getError(result));
+    releaseHandle(handle);
+    return false;
+  }
+  releaseHandle(handle);
+  return true;
+}
+
+void SecurityContext::leftShift(std::array<uint8_t, 16> &data) {
+  bool carry1 = false;
+  bool carry2 = false;
+  for (int32_t i = data.size() - 1; i >= 0; i--) {
+    carry1 = (data[i] & 0x80) == 0x80;
+    data[i] = data[i] << 1;
+    if (carry2) data[i] |= 1;
+    carry2 = carry1;
   }
 }
 
+Security::Security(BaseLib::SharedObjects *bl) : _bl(bl) {
+}
+
 Security::~Security() {
-  if (_encryptHandle) gcry_cipher_close(_encryptHandle);
-  _encryptHandle = nullptr;
 }
 
-std::vector<uint8_t> Security::encryptRollingCode(const std::vector<uint8_t> &deviceAesKey, uint32_t rollingCode, int32_t rollingCodeSize) {
+std::vector<uint8_t> Security::encryptRollingCode(SecurityContext &context, uint32_t rollingCode, int32_t rollingCodeSize) {
   try {
     std::vector<uint8_t> plain{0x34, 0x10, (uint8_t)0xde, (uint8_t)0x8f, 0x1a, (uint8_t)0xba, 0x3e, (uint8_t)0xff, (uint8_t)0x9f, 0x5a, 0x11, 0x71, 0x72, (uint8_t)0xea, (uint8_t)0xca, (uint8_t)0xbd};
     if (rollingCodeSize == 4) {
@@ -41,20 +175,7 @@ std::vector<uint8_t> Security::encryptRollingCode(const std::vector<uint8_t> &de
     }
 
     std::vector<uint8_t> encryptedRollingCode(16);
-    {
-      int32_t result = 0;
-      std::lock_guard<std::mutex> encryptGuard(_encryptMutex);
-      if ((result = gcry_cipher_setkey(_encryptHandle, deviceAesKey.data(), deviceAesKey.size())) != GPG_ERR_NO_ERROR) {
-        Gd::out.printError("Error: Could not set key for encryption: " + BaseLib::Security::Gcrypt::getError(result));
-        return std::vector<uint8_t>();
-      }
-
-      if ((result = gcry_cipher_encrypt(_encryptHandle, encryptedRollingCode.data(), encryptedRollingCode.size(), plain.data(), plain.size())) != GPG_ERR_NO_ERROR) {
-        Gd::out.printError("Error encrypting data: " + BaseLib::Security::Gcrypt::getError(result));
-        return std::vector<uint8_t>();
-      }
-    }
-
+    if (!context.encrypt(encryptedRollingCode.data(), plain.data(), plain.size())) return std::vector<uint8_t>();
     return encryptedRollingCode;
   }
   catch (const std::exception &ex) {
@@ -63,9 +184,9 @@ std::vector<uint8_t> Security::encryptRollingCode(const std::vector<uint8_t> &de
   return std::vector<uint8_t>();
 }
 
-bool Security::encryptExplicitRlc(const std::vector<uint8_t> &deviceAesKey, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
+bool Security::encryptExplicitRlc(SecurityContext &context, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
   try {
-    std::vector<uint8_t> encryptedRollingCode = encryptRollingCode(deviceAesKey, rollingCode, rollingCodeSize);
+    std::vector<uint8_t> encryptedRollingCode = encryptRollingCode(context, rollingCode, rollingCodeSize);
     if (encryptedRollingCode.empty()) return false;
 
     if (dataSize > 16) {
@@ -82,7 +203,7 @@ bool Security::encryptExplicitRlc(const std::vector<uint8_t> &deviceAesKey, std:
 
     encryptedData.push_back(0x31);
     encryptedData.insert(encryptedData.end(), data.begin(), data.begin() + dataSize);
-    auto cmac = getCmac(deviceAesKey, encryptedData, encryptedData.size(), rollingCode, rollingCodeSize, cmacSize);
+    auto cmac = getCmac(context, encryptedData, encryptedData.size(), rollingCode, rollingCodeSize, cmacSize);
     encryptedData.push_back(rollingCode >> 24);
     encryptedData.push_back(rollingCode >> 16);
     encryptedData.push_back(rollingCode >> 8);
@@ -99,9 +220,9 @@ bool Security::encryptExplicitRlc(const std::vector<uint8_t> &deviceAesKey, std:
   return false;
 }
 
-bool Security::decrypt(const std::vector<uint8_t> &deviceAesKey, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize) {
+bool Security::decrypt(SecurityContext &context, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize) {
   try {
-    std::vector<uint8_t> encryptedRollingCode = encryptRollingCode(deviceAesKey, rollingCode, rollingCodeSize);
+    std::vector<uint8_t> encryptedRollingCode = encryptRollingCode(context, rollingCode, rollingCodeSize);
     if (encryptedRollingCode.empty()) return false;
 
     if (dataSize > 17) {
@@ -123,17 +244,49 @@ bool Security::decrypt(const std::vector<uint8_t> &deviceAesKey, std::vector<uin
   return false;
 }
 
-bool Security::checkCmacImplicitRlc(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
+bool Security::checkCmacImplicitRlc(SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
   try {
+    if (dataSize < 0 || cmacSize <= 0 || cmacSize > 16 || rollingCodeSize < 2 || rollingCodeSize > 4) return false;
     if ((signed)encryptedData.size() < dataSize + cmacSize) return false;
-    for (uint32_t currentRollingCode = rollingCode; currentRollingCode < rollingCode + 128; currentRollingCode++) {
-      std::vector<uint8_t> cmacInPacket(encryptedData.begin() + dataSize, encryptedData.begin() + dataSize + cmacSize);
-      std::vector<uint8_t> calculatedCmac = getCmac(deviceAesKey, encryptedData, dataSize, currentRollingCode, rollingCodeSize, cmacSize);
-      if (cmacInPacket.empty() || calculatedCmac.empty()) return false;
-
-      if (cmacInPacket.size() == calculatedCmac.size() && std::equal(cmacInPacket.begin(), cmacInPacket.end(), calculatedCmac.begin())) {
-        rollingCode = currentRollingCode;
-        return true;
+
+    //Only the last block of the message is encrypted into the CMAC (see getCmac()), so this is the only block which
+    //needs to be built per rolling code. The rolling code is at the end of the message, the bytes before it are the
+    //same for all candidates.
+    uint32_t messageSize = dataSize + rollingCodeSize;
+    bool aligned = (messageSize % 16 == 0);
+    uint32_t lastBlockStart = ((messageSize + 15) / 16 - 1) * 16;
+    auto &subkey = aligned ? context.getSubkey1() : context.getSubkey2();
+    std::array<uint8_t, 16> lastBlock{};
+    for (uint32_t i = 0; i < 16; i++) {
+      uint32_t position = lastBlockStart + i;
+      if (position < (unsigned)dataSize) lastBlock[i] = encryptedData[position];
+      else if (position == messageSize) lastBlock[i] = 0x80;
+      lastBlock[i] ^= subkey[i];
+    }
+
+    //The expected rolling code is checked first, as this is the usual case. Then the rest of the window in one batch,
+    //which lets libgcrypt use its pipelined multi-block code.
+    std::array<uint8_t, rollingCodeWindow * 16> blocks{};
+    for (uint32_t batchStart = 0, batchSize = 1; batchStart < rollingCodeWindow; batchStart += batchSize, batchSize = rollingCodeWindow - batchStart) {
+      for (uint32_t candidate = 0; candidate < batchSize; candidate++) {
+        uint32_t currentRollingCode = rollingCode + batchStart + candidate;
+        uint8_t *block = blocks.data() + candidate * 16;
+        std::copy(lastBlock.begin(), lastBlock.end(), block);
+        for (uint32_t i = 0; i < (unsigned)rollingCodeSize; i++) {
+          uint32_t position = dataSize + i;
+          if (position < lastBlockStart) continue;
+          block[position - lastBlockStart] ^= (uint8_t)(currentRollingCode >> ((rollingCodeSize - 1 - i) * 8));
+        }
+      }
+
+      if (!context.encrypt(blocks.data(), blocks.data(), batchSize * 16)) return false;
+
+      for (uint32_t candidate = 0; candidate < batchSize; candidate++) {
+        const uint8_t *cmac = blocks.data() + candidate * 16;
+        if (std::equal(cmac, cmac + cmacSize, encryptedData.begin() + dataSize)) {
+          rollingCode = rollingCode + batchStart + candidate;
+          return true;
+        }
       }
     }
 
@@ -145,7 +298,7 @@ bool Security::checkCmacImplicitRlc(const std::vector<uint8_t> &deviceAesKey, co
   return false;
 }
 
-bool Security::checkCmacExplicitRlc(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, uint32_t lastRollingCode, uint32_t &newRollingCode, int32_t dataSize, int32_t rollingCodeSize, int32_t cmacSize) {
+bool Security::checkCmacExplicitRlc(SecurityContext &context, const std::vector<uint8_t> &encryptedData, uint32_t lastRollingCode, uint32_t &newRollingCode, int32_t dataSize, int32_t rollingCodeSize, int32_t cmacSize) {
   try {
     if ((signed)encryptedData.size() < dataSize + rollingCodeSize + cmacSize) return false;
     uint32_t rollingCode = 0;
@@ -154,11 +307,17 @@ bool Security::checkCmacExplicitRlc(const std::vector<uint8_t> &deviceAesKey, co
     else if (rollingCodeSize == 2) rollingCode = (((uint32_t)encryptedData.at(dataSize)) << 8) | encryptedData.at(dataSize + 1);
     else return false;
 
-    if (lastRollingCode >= rollingCode) return false;
+    //No code was received yet.
+    if (lastRollingCode == 0xFFFFFFFF) return false;
+    //The rolling code has to be ahead of the last one by less than half the range. This also accepts codes after a
+    //wrap around.
+    uint32_t mask = rollingCodeSize == 4 ? 0xFFFFFFFF : (1u << (rollingCodeSize * 8)) - 1;
+    uint32_t distance = (rollingCode - lastRollingCode) & mask;
+    if (distance == 0 || distance > mask / 2) return false;
     newRollingCode = rollingCode;
 
     std::vector<uint8_t> cmacInPacket(encryptedData.begin() + dataSize + rollingCodeSize, encryptedData.begin() + dataSize + rollingCodeSize + cmacSize);
-    std::vector<uint8_t> calculatedCmac = getCmac(deviceAesKey, encryptedData, dataSize, rollingCode, rollingCodeSize, cmacSize);
+    std::vector<uint8_t> calculatedCmac = getCmac(context, encryptedData, dataSize, rollingCode, rollingCodeSize, cmacSize);
 
     if (cmacInPacket.empty() || calculatedCmac.empty()) return false;
 
@@ -170,7 +329,7 @@ bool Security::checkCmacExplicitRlc(const std::vector<uint8_t> &deviceAesKey, co
   return false;
 }
 
-std::vector<uint8_t> Security::getCmac(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
+std::vector<uint8_t> Security::getCmac(SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
   try {
     std::vector<uint8_t> plain;
     plain.reserve(16);
@@ -194,16 +353,8 @@ std::vector<uint8_t> Security::getCmac(const std::vector<uint8_t> &deviceAesKey,
     if ((plain.size() % 16) != 0) plain.push_back(0x80);
     while ((plain.size() % 16) != 0) plain.push_back(0);
 
-    std::vector<uint8_t> subkeyAligned = getSubkey(deviceAesKey, true);
-    std::vector<uint8_t> subkeyNonAligned = getSubkey(deviceAesKey, false);
-    if (subkeyAligned.size() != 16 || subkeyNonAligned.size() != 16) return std::vector<uint8_t>();
-
-    std::lock_guard<std::mutex> encryptGuard(_encryptMutex);
-    int32_t result = 0;
-    if ((result = gcry_cipher_setkey(_encryptHandle, deviceAesKey.data(), deviceAesKey.size())) != GPG_ERR_NO_ERROR) {
-      Gd::out.printError("Error: Could not set key for encryption: " + BaseLib::Security::Gcrypt::getError(result));
-      return std::vector<uint8_t>();
-    }
+    auto &subkeyAligned = context.getSubkey1();
+    auto &subkeyNonAligned = context.getSubkey2();
 
     std::vector<uint8_t> cmac(16);
     uint32_t currentBlock = 0;
@@ -213,10 +364,7 @@ std::vector<uint8_t> Security::getCmac(const std::vector<uint8_t> &deviceAesKey,
       else plain[i] ^= subkeyAligned[i % 16];
 
       if ((i % 16) == 15) {
-        if ((result = gcry_cipher_encrypt(_encryptHandle, cmac.data(), cmac.size(), plain.data() + (currentBlock * 16), 16)) != GPG_ERR_NO_ERROR) {
-          Gd::out.printError("Error encrypting data: " + BaseLib::Security::Gcrypt::getError(result));
-          return std::vector<uint8_t>();
-        }
+        if (!context.encrypt(cmac.data(), plain.data() + (currentBlock * 16), 16)) return std::vector<uint8_t>();
         currentBlock++;
       }
     }
@@ -230,56 +378,4 @@ std::vector<uint8_t> Security::getCmac(const std::vector<uint8_t> &deviceAesKey,
   return std::vector<uint8_t>();
 }
 
-void Security::leftShiftVector(std::vector<uint8_t> &data) {
-  try {
-    bool carry1 = false;
-    bool carry2 = false;
-    for (int32_t i = data.size() - 1; i >= 0; i--) {
-      carry1 = (data[i] & 0x80) == 0x80;
-      data[i] = data[i] << 1;
-      if (carry2) data[i] |= 1;
-      carry2 = carry1;
-    }
-  }
-  catch (const std::exception &ex) {
-    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-  }
-}
-
-std::vector<uint8_t> Security::getSubkey(const std::vector<uint8_t> &deviceAesKey, bool aligned) {
-  try {
-    std::vector<uint8_t> subkey(16);
-    int32_t result = 0;
-
-    {
-      std::lock_guard<std::mutex> encryptGuard(_encryptMutex);
-      if ((result = gcry_cipher_setkey(_encryptHandle, deviceAesKey.data(), deviceAesKey.size())) != GPG_ERR_NO_ERROR) {
-        Gd::out.printError("Error: Could not set key for encryption: " + BaseLib::Security::Gcrypt::getError(result));
-        return std::vector<uint8_t>();
-      }
-
-      if ((result = gcry_cipher_encrypt(_encryptHandle, subkey.data(), subkey.size(), (void *)_subkeyInput, 16)) != GPG_ERR_NO_ERROR) {
-        Gd::out.printError("Error encrypting data: " + BaseLib::Security::Gcrypt::getError(result));
-        return std::vector<uint8_t>();
-      }
-    }
-
-    bool useConstRb = (subkey[0] & 0x80);
-    leftShiftVector(subkey);
-    if (useConstRb) subkey[15] ^= (uint8_t)0x87;
-
-    if (aligned) return subkey; //K1
-
-    useConstRb = (subkey[0] & 0x80);
-    leftShiftVector(subkey);
-    if (useConstRb) subkey[15] ^= (uint8_t)0x87;
-
-    return subkey; //K2
-  }
-  catch (const std::exception &ex) {
-    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-  }
-  return std::vector<uint8_t>();
-}
-
 }
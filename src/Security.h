@@ -3,33 +3,112 @@
 #ifndef SECURITY_H_
 #define SECURITY_H_
 
+#include "Aes128.h"
+
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 
 #include <homegear-base/BaseLib.h>
 
 namespace EnOcean {
 
+/**
+ * The expanded AES key of a device and the CMAC subkeys K1 and K2 derived from it.
+ *
+ * The key is set on the cipher handles once, so encrypting rolling codes and calculating CMACs only costs the block
+ * encryptions. A context belongs to one key: When the key changes, a new context is created.
+ *
+ * Cipher handles are not thread safe, so every encryption takes a keyed handle from a small pool and returns it
+ * afterwards. Threads using the same context at the same time get different handles and never wait for each other
+ * while encrypting; an additional handle is only created (and the key expanded again) when all handles are in use.
+ * Handles and the copy of the key needed to create them are in secure memory.
+ *
+ * Depending on the family setting "aesBackend" blocks are encrypted by the built-in AES implementation instead (see
+ * Aes128). It needs no handles, its round keys are only read.
+ */
+class SecurityContext {
+ public:
+  /**
+   * Uses the AES implementation selected by the family setting "aesBackend".
+   */
+  explicit SecurityContext(const std::vector<uint8_t> &aesKey);
+
+  /**
+   * @param implementation Aes128::Implementation::none to use libgcrypt.
+   */
+  SecurityContext(const std::vector<uint8_t> &aesKey, Aes128::Implementation implementation);
+  ~SecurityContext();
+  SecurityContext(const SecurityContext &) = delete;
+  SecurityContext &operator=(const SecurityContext &) = delete;
+
+  /**
+   * @return False when the key could not be set, e. g. because it doesn't have 16 bytes.
+   */
+  bool isValid() const { return _valid; }
+
+  /**
+   * Encrypts whole 16 byte blocks (ECB). "in" and "out" may be the same. Thread safe.
+   */
+  bool encrypt(uint8_t *out, const uint8_t *in, size_t size);
+
+  const std::array<uint8_t, 16> &getSubkey1() const { return _subkey1; }
+  const std::array<uint8_t, 16> &getSubkey2() const { return _subkey2; }
+
+  Aes128::Implementation getImplementation() const { return _nativeAes ? _nativeAes->getImplementation() : Aes128::Implementation::none; }
+ private:
+  //Handles kept when not in use. More are created when needed, but closed again when returned.
+  static constexpr size_t _maxIdleHandles = 4;
+
+  bool _valid = false;
+  uint8_t *_aesKey = nullptr;
+  size_t _aesKeySize = 0;
+  std::array<uint8_t, 16> _subkey1{};
+  std::array<uint8_t, 16> _subkey2{};
+
+  std::mutex _handlesMutex;
+  std::vector<gcry_cipher_hd_t> _idleHandles;
+
+  std::unique_ptr<Aes128> _nativeAes;
+
+  static Aes128::Implementation getConfiguredImplementation();
+  void deriveSubkeys();
+  gcry_cipher_hd_t createHandle();
+  gcry_cipher_hd_t acquireHandle();
+  void releaseHandle(gcry_cipher_hd_t handle);
+  static void leftShift(std::array<uint8_t, 16> &data);
+};
+
+typedef std::shared_ptr<SecurityContext> PSecurityContext;
+
 class Security {
  public:
+  /**
+   * Number of rolling codes checked for telegrams with implicit rolling code.
+   */
+  static constexpr uint32_t rollingCodeWindow = 128;
+
   Security(BaseLib::SharedObjects *bl);
   virtual ~Security();
 
-  bool encryptExplicitRlc(const std::vector<uint8_t> &deviceAesKey, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
-  bool decrypt(const std::vector<uint8_t> &deviceAesKey, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize);
-  bool checkCmacImplicitRlc(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
-  bool checkCmacExplicitRlc(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, uint32_t lastRollingCode, uint32_t &newRollingCode, int32_t dataSize, int32_t rollingCodeSize, int32_t cmacSize);
-  std::vector<uint8_t> getCmac(const std::vector<uint8_t> &deviceAesKey, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
- protected:
-  BaseLib::SharedObjects *_bl = nullptr;
+  bool encryptExplicitRlc(SecurityContext &context, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
+  bool decrypt(SecurityContext &context, std::vector<uint8_t> &data, uint32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize);
 
-  const uint8_t _subkeyInput[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  /**
+   * Searches the rolling code window for the rolling code the CMAC was calculated with. Instead of calculating one CMAC
+   * after the other, the last CMAC blocks of all candidates are built and encrypted in one batch.
+   *
+   * @param[in,out] rollingCode The first rolling code to check. Set to the matching rolling code on success.
+   */
+  bool checkCmacImplicitRlc(SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
+  bool checkCmacExplicitRlc(SecurityContext &context, const std::vector<uint8_t> &encryptedData, uint32_t lastRollingCode, uint32_t &newRollingCode, int32_t dataSize, int32_t rollingCodeSize, int32_t cmacSize);
+  std::vector<uint8_t> getCmac(SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
 
-  std::mutex _encryptMutex;
-  gcry_cipher_hd_t _encryptHandle = nullptr;
+ protected:
+  BaseLib::SharedObjects *_bl = nullptr;
 
-  std::vector<uint8_t> encryptRollingCode(const std::vector<uint8_t> &deviceAesKey, uint32_t rollingCode, int32_t rollingCodeSize);
-  std::vector<uint8_t> getSubkey(const std::vector<uint8_t> &deviceAesKey, bool aligned);
-  void leftShiftVector(std::vector<uint8_t> &data);
+  std::vector<uint8_t> encryptRollingCode(SecurityContext &context, uint32_t rollingCode, int32_t rollingCodeSize);
 };
 
 typedef std::shared_ptr<Security> PSecurity;
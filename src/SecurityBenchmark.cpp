@@ -0,0 +1,472 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "SecurityBenchmark.h"
+#include "Security.h"
+#include "Gd.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace EnOcean {
+
+namespace {
+
+const std::string rfc4493Key = "2B7E151628AED2A6ABF7158809CF4F3C";
+
+std::vector<uint8_t> getRollingCodeBytes(uint32_t rollingCode, int32_t rollingCodeSize) {
+  std::vector<uint8_t> bytes;
+  for (int32_t i = rollingCodeSize - 1; i >= 0; i--) {
+    bytes.push_back((uint8_t)(rollingCode >> (i * 8)));
+  }
+  return bytes;
+}
+
+/**
+ * The untruncated AES-CMAC of libgcrypt.
+ */
+std::vector<uint8_t> getReferenceCmac(const std::vector<uint8_t> &key, const std::vector<uint8_t> &message) {
+  gcry_mac_hd_t handle = nullptr;
+  if (gcry_mac_open(&handle, GCRY_MAC_CMAC_AES, 0, nullptr) != GPG_ERR_NO_ERROR || !handle) return std::vector<uint8_t>();
+  std::vector<uint8_t> cmac(16);
+  size_t cmacSize = cmac.size();
+  bool success = gcry_mac_setkey(handle, key.data(), key.size()) == GPG_ERR_NO_ERROR && gcry_mac_write(handle, message.data(), message.size()) == GPG_ERR_NO_ERROR && gcry_mac_read(handle, cmac.data(), &cmacSize) == GPG_ERR_NO_ERROR;
+  gcry_mac_close(handle);
+  if (!success || cmacSize != 16) return std::vector<uint8_t>();
+  return cmac;
+}
+
+std::vector<uint8_t> encryptReferenceBlock(const std::vector<uint8_t> &key, const std::vector<uint8_t> &block) {
+  gcry_cipher_hd_t handle = nullptr;
+  if (gcry_cipher_open(&handle, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_ECB, 0) != GPG_ERR_NO_ERROR || !handle) return std::vector<uint8_t>();
+  std::vector<uint8_t> encryptedBlock(16);
+  bool success = gcry_cipher_setkey(handle, key.data(), key.size()) == GPG_ERR_NO_ERROR && gcry_cipher_encrypt(handle, encryptedBlock.data(), encryptedBlock.size(), block.data(), block.size()) == GPG_ERR_NO_ERROR;
+  gcry_cipher_close(handle);
+  if (!success) return std::vector<uint8_t>();
+  return encryptedBlock;
+}
+
+}
+
+SecurityBenchmark::TestResult SecurityBenchmark::runKnownAnswerTests() {
+  TestResult result;
+  try {
+    runKnownAnswerTests(Aes128::Implementation::none, result);
+    for (auto implementation : Aes128::getVerifiedImplementations()) {
+      runKnownAnswerTests(implementation, result);
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    result.failures.emplace_back(std::string("Exception: ") + ex.what());
+  }
+  return result;
+}
+
+void SecurityBenchmark::runKnownAnswerTests(Aes128::Implementation implementation, TestResult &result) {
+  std::string prefix = Aes128::getName(implementation) + ": ";
+  auto check = [&](bool passed, const std::string &description) {
+    if (passed) result.passed++;
+    else result.failures.push_back(prefix + description);
+  };
+
+  Security security(Gd::bl);
+  auto key = BaseLib::HelperFunctions::getUBinary(rfc4493Key);
+  SecurityContext context(key, implementation);
+  if (!context.isValid() || context.getImplementation() != implementation) {
+    check(false, "Could not create security context.");
+    return;
+  }
+
+  //{{{ AES and CMAC subkeys
+  auto plain = BaseLib::HelperFunctions::getUBinary("6BC1BEE22E409F96E93D7E117393172A");
+  std::vector<uint8_t> cipher(16);
+  check(context.encrypt(cipher.data(), plain.data(), plain.size()) && cipher == BaseLib::HelperFunctions::getUBinary("3AD77BB40D7A3660A89ECAF32466EF97"), "AES block (SP 800-38A F.1.1)");
+  check(std::vector<uint8_t>(context.getSubkey1().begin(), context.getSubkey1().end()) == BaseLib::HelperFunctions::getUBinary("FBEED618357133667C85E08F7236A8DE"), "Subkey K1 (RFC 4493)");
+  check(std::vector<uint8_t>(context.getSubkey2().begin(), context.getSubkey2().end()) == BaseLib::HelperFunctions::getUBinary("F7DDAC306AE266CCF90BC11EE46D513B"), "Subkey K2 (RFC 4493)");
+  //}}}
+
+  std::mt19937 generator(0x454E4F43);
+  std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+  auto getRandomBytes = [&](size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+      byte = (uint8_t)byteDistribution(generator);
+    }
+    return bytes;
+  };
+
+  for (int32_t rollingCodeSize = 2; rollingCodeSize <= 4; rollingCodeSize++) {
+    std::string sizes = " (" + std::to_string(rollingCodeSize) + " byte rolling code)";
+
+    //{{{ CMAC
+    //RFC 4493, example 2: The last bytes of the message are the rolling code.
+    auto expectedCmac = BaseLib::HelperFunctions::getUBinary("070A16B46B4D4144F79BDD9DD04A287C");
+    std::vector<uint8_t> data(plain.begin(), plain.end() - rollingCodeSize);
+    uint32_t rollingCode = 0;
+    for (auto i = plain.end() - rollingCodeSize; i != plain.end(); ++i) {
+      rollingCode = (rollingCode << 8u) | *i;
+    }
+    for (int32_t cmacSize = 3; cmacSize <= 4; cmacSize++) {
+      auto cmac = security.getCmac(context, data, data.size(), rollingCode, rollingCodeSize, cmacSize);
+      check(cmac == std::vector<uint8_t>(expectedCmac.begin(), expectedCmac.begin() + cmacSize), "CMAC of RFC 4493 example 2 with " + std::to_string(cmacSize) + " bytes" + sizes);
+    }
+
+    //Messages shorter than a block use K2 and padding.
+    bool cmacsMatch = true;
+    for (int32_t dataSize = 1; dataSize <= 16 - rollingCodeSize; dataSize++) {
+      data = getRandomBytes(dataSize);
+      rollingCode = byteDistribution(generator) << 8u | byteDistribution(generator);
+      auto message = data;
+      auto rollingCodeBytes = getRollingCodeBytes(rollingCode, rollingCodeSize);
+      message.insert(message.end(), rollingCodeBytes.begin(), rollingCodeBytes.end());
+      auto referenceCmac = getReferenceCmac(key, message);
+      auto cmac = security.getCmac(context, data, data.size(), rollingCode, rollingCodeSize, 4);
+      if (referenceCmac.empty() || cmac != std::vector<uint8_t>(referenceCmac.begin(), referenceCmac.begin() + 4)) cmacsMatch = false;
+    }
+    check(cmacsMatch, "CMAC of 1 to " + std::to_string(16 - rollingCodeSize) + " byte telegrams compared to libgcrypt" + sizes);
+    //}}}
+
+    //{{{ Rolling code encryption
+    //The data is XORed with the encrypted public constant, which has the rolling code XORed into its first bytes.
+    rollingCode = 0x01020304u & (0xFFFFFFFFu >> ((4 - rollingCodeSize) * 8));
+    auto keyStreamInput = BaseLib::HelperFunctions::getUBinary("3410DE8F1ABA3EFF9F5A117172EACABD");
+    auto rollingCodeBytes = getRollingCodeBytes(rollingCode, rollingCodeSize);
+    for (int32_t i = 0; i < rollingCodeSize; i++) {
+      keyStreamInput[i] ^= rollingCodeBytes[i];
+    }
+    auto keyStream = encryptReferenceBlock(key, keyStreamInput);
+    data = getRandomBytes(17);
+    data[0] = 0x30;
+    auto expectedData = data;
+    expectedData[0] = 0x32;
+    for (uint32_t i = 1; i < expectedData.size() && !keyStream.empty(); i++) {
+      expectedData[i] ^= keyStream[i - 1];
+    }
+    check(!keyStream.empty() && security.decrypt(context, data, data.size(), rollingCode, rollingCodeSize) && data == expectedData, "Decryption compared to libgcrypt" + sizes);
+    //}}}
+
+    //{{{ Implicit rolling code
+    for (int32_t cmacSize = 3; cmacSize <= 4; cmacSize++) {
+      std::string cmacSizes = " (" + std::to_string(rollingCodeSize) + " byte rolling code, " + std::to_string(cmacSize) + " byte CMAC)";
+      auto telegram = getRandomBytes(5);
+      telegram[0] = 0x30;
+      uint32_t firstRollingCode = 0x0100;
+      for (uint32_t offset : {0u, 1u, Security::rollingCodeWindow - 1, Security::rollingCodeWindow}) {
+        auto signedTelegram = telegram;
+        auto cmac = security.getCmac(context, signedTelegram, signedTelegram.size(), firstRollingCode + offset, rollingCodeSize, cmacSize);
+        signedTelegram.insert(signedTelegram.end(), cmac.begin(), cmac.end());
+        uint32_t batchedRollingCode = firstRollingCode;
+        uint32_t sequentialRollingCode = firstRollingCode;
+        bool batched = security.checkCmacImplicitRlc(context, signedTelegram, telegram.size(), batchedRollingCode, rollingCodeSize, cmacSize);
+        bool sequential = checkCmacImplicitRlcSequential(security, context, signedTelegram, telegram.size(), sequentialRollingCode, rollingCodeSize, cmacSize);
+        if (offset < Security::rollingCodeWindow) {
+          check(batched && batchedRollingCode == firstRollingCode + offset && sequential && sequentialRollingCode == firstRollingCode + offset, "Implicit rolling code found at offset " + std::to_string(offset) + cmacSizes);
+        } else {
+          check(!batched && !sequential, "Implicit rolling code outside of the window rejected" + cmacSizes);
+        }
+      }
+
+      auto signedTelegram = telegram;
+      auto cmac = security.getCmac(context, signedTelegram, signedTelegram.size(), firstRollingCode, rollingCodeSize, cmacSize);
+      signedTelegram.insert(signedTelegram.end(), cmac.begin(), cmac.end());
+      signedTelegram.back() ^= 0x01;
+      uint32_t tamperedRollingCode = firstRollingCode;
+      check(!security.checkCmacImplicitRlc(context, signedTelegram, telegram.size(), tamperedRollingCode, rollingCodeSize, cmacSize), "Implicit rolling code telegram with modified CMAC rejected" + cmacSizes);
+    }
+    //}}}
+  }
+
+  //{{{ Explicit rolling code
+  //encryptExplicitRlc() always appends four rolling code bytes, so the round trip is only possible with 4 byte rolling codes.
+  for (int32_t cmacSize = 3; cmacSize <= 4; cmacSize++) {
+    std::string cmacSizes = " (4 byte rolling code, " + std::to_string(cmacSize) + " byte CMAC)";
+    auto payload = getRandomBytes(4);
+    auto telegram = payload;
+    uint32_t rollingCode = 0x00012345;
+    bool encrypted = security.encryptExplicitRlc(context, telegram, telegram.size(), rollingCode, 4, cmacSize);
+    check(encrypted && telegram.size() == 1 + payload.size() + 4 + (size_t)cmacSize && telegram.at(0) == 0x31, "Explicit rolling code telegram encrypted" + cmacSizes);
+    if (!encrypted) continue;
+
+    uint32_t newRollingCode = 0;
+    check(security.checkCmacExplicitRlc(context, telegram, rollingCode - 1, newRollingCode, 5, 4, cmacSize) && newRollingCode == rollingCode, "Explicit rolling code telegram verified" + cmacSizes);
+    check(!security.checkCmacExplicitRlc(context, telegram, rollingCode, newRollingCode, 5, 4, cmacSize), "Replayed explicit rolling code telegram rejected" + cmacSizes);
+    check(security.checkCmacExplicitRlc(context, telegram, 0xFFFFFFF0, newRollingCode, 5, 4, cmacSize) && newRollingCode == rollingCode, "Explicit rolling code telegram verified after wrap around" + cmacSizes);
+    check(!security.checkCmacExplicitRlc(context, telegram, rollingCode + 0x10, newRollingCode, 5, 4, cmacSize), "Explicit rolling code telegram with old rolling code rejected" + cmacSizes);
+    auto tamperedTelegram = telegram;
+    tamperedTelegram.back() ^= 0x01;
+    check(!security.checkCmacExplicitRlc(context, tamperedTelegram, rollingCode - 1, newRollingCode, 5, 4, cmacSize), "Explicit rolling code telegram with modified CMAC rejected" + cmacSizes);
+
+    auto decryptedTelegram = telegram;
+    check(security.decrypt(context, decryptedTelegram, 5, rollingCode, 4) && decryptedTelegram.at(0) == 0x32 && std::equal(payload.begin(), payload.end(), decryptedTelegram.begin() + 1), "Explicit rolling code telegram decrypted" + cmacSizes);
+  }
+  //}}}
+}
+
+std::vector<SecurityBenchmark::Result> SecurityBenchmark::run(uint32_t rounds, uint32_t threads) {
+  std::vector<Result> results;
+  try {
+    if (rounds == 0) return results;
+    if (threads == 0) threads = 1;
+
+    std::mt19937 generator(rounds);
+    std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+    std::vector<uint8_t> aesKey(16);
+    for (auto &byte : aesKey) {
+      byte = (uint8_t)byteDistribution(generator);
+    }
+    //Uses the AES backend configured for devices.
+    SecurityContext context(aesKey);
+    if (!context.isValid()) return results;
+    std::vector<uint32_t> threadCounts{1};
+    if (threads > 1) threadCounts.push_back(threads);
+
+    for (int32_t rollingCodeSize = 2; rollingCodeSize <= 4; rollingCodeSize++) {
+      for (int32_t cmacSize = 3; cmacSize <= 4; cmacSize++) {
+        for (auto threadCount : threadCounts) {
+          Result result;
+          result.rollingCodeSize = rollingCodeSize;
+          result.cmacSize = cmacSize;
+          result.threads = threadCount;
+
+          //All threads use the same context, as threads processing telegrams of the same device would.
+          std::vector<ThreadResult> threadResults(threadCount);
+          std::vector<std::thread> benchmarkThreads(threadCount);
+          for (uint32_t i = 0; i < threadCount; i++) {
+            Gd::bl->threadManager.start(benchmarkThreads[i], true, &SecurityBenchmark::benchmarkThread, &context, rollingCodeSize, cmacSize, rounds, &threadResults[i]);
+          }
+          for (auto &thread : benchmarkThreads) {
+            Gd::bl->threadManager.join(thread);
+          }
+
+          for (auto &threadResult : threadResults) {
+            result.telegrams += threadResult.telegrams;
+            result.verifyExplicitNanoseconds += threadResult.verifyExplicitNanoseconds;
+            result.verifyImplicitNanoseconds += threadResult.verifyImplicitNanoseconds;
+            result.encryptNanoseconds += threadResult.encryptNanoseconds;
+          }
+          //A thread failed to verify its telegrams.
+          if (result.telegrams != (uint64_t)rounds * threadCount) result.telegrams = 0;
+          results.push_back(result);
+        }
+      }
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return results;
+}
+
+SecurityBenchmark::WindowSearchResult SecurityBenchmark::runWindowSearch(uint32_t rounds) {
+  WindowSearchResult result;
+  if (rounds == 0) return result;
+
+  std::mt19937 generator(rounds);
+  std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+  std::vector<uint8_t> aesKey(16);
+  for (auto &byte : aesKey) {
+    byte = (uint8_t)byteDistribution(generator);
+  }
+  SecurityContext context(aesKey);
+  if (!context.isValid()) return result;
+  Security security(Gd::bl);
+
+  //Typical secure 4BS telegram: RORG 0x30, 4 data bytes, 3 byte rolling code, 4 byte CMAC.
+  const int32_t dataSize = 5;
+  const int32_t rollingCodeSize = 3;
+  const int32_t cmacSize = 4;
+  std::vector<uint8_t> telegram{0x30};
+  for (int32_t i = 1; i < dataSize; i++) {
+    telegram.push_back((uint8_t)byteDistribution(generator));
+  }
+
+  //Both implementations need to find the same rolling code.
+  uint32_t expectedRollingCode = 0x1000 + rounds % 100;
+  auto validTelegram = telegram;
+  auto cmac = security.getCmac(context, validTelegram, dataSize, expectedRollingCode, rollingCodeSize, cmacSize);
+  validTelegram.insert(validTelegram.end(), cmac.begin(), cmac.end());
+  uint32_t sequentialRollingCode = 0x1000;
+  uint32_t batchedRollingCode = 0x1000;
+  if (!checkCmacImplicitRlcSequential(security, context, validTelegram, dataSize, sequentialRollingCode, rollingCodeSize, cmacSize) || sequentialRollingCode != expectedRollingCode) return result;
+  if (!security.checkCmacImplicitRlc(context, validTelegram, dataSize, batchedRollingCode, rollingCodeSize, cmacSize) || batchedRollingCode != expectedRollingCode) return result;
+
+  //A CMAC which is not valid for any rolling code of the window
+  auto invalidTelegram = telegram;
+  cmac = security.getCmac(context, invalidTelegram, dataSize, 0x1000 + Security::rollingCodeWindow, rollingCodeSize, cmacSize);
+  invalidTelegram.insert(invalidTelegram.end(), cmac.begin(), cmac.end());
+  result.telegrams = rounds;
+
+  //The checksum keeps the compiler from removing the loops.
+  volatile uint32_t checksum = 0;
+
+  auto startTime = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    uint32_t rollingCode = 0x1000;
+    checksum = checksum + (checkCmacImplicitRlcSequential(security, context, invalidTelegram, dataSize, rollingCode, rollingCodeSize, cmacSize) ? 1 : 0);
+  }
+  result.sequentialNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  startTime = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    uint32_t rollingCode = 0x1000;
+    checksum = checksum + (security.checkCmacImplicitRlc(context, invalidTelegram, dataSize, rollingCode, rollingCodeSize, cmacSize) ? 1 : 0);
+  }
+  result.batchedNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  if (checksum != 0) result.telegrams = 0;
+  return result;
+}
+
+std::vector<SecurityBenchmark::BackendResult> SecurityBenchmark::runBackends(uint32_t rounds) {
+  std::vector<BackendResult> results;
+  if (rounds == 0) return results;
+
+  std::mt19937 generator(rounds);
+  std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+  std::vector<uint8_t> aesKey(16);
+  for (auto &byte : aesKey) {
+    byte = (uint8_t)byteDistribution(generator);
+  }
+  Security security(Gd::bl);
+
+  //Typical secure VLD telegram: RORG 0x31, 6 data bytes, 4 byte rolling code, 4 byte CMAC.
+  const int32_t rollingCodeSize = 4;
+  const int32_t cmacSize = 4;
+  std::vector<uint8_t> data;
+  for (int32_t i = 0; i < 6; i++) {
+    data.push_back((uint8_t)byteDistribution(generator));
+  }
+  std::vector<uint8_t> message{0x31};
+  message.insert(message.end(), data.begin(), data.end());
+
+  std::vector<uint8_t> expectedCmac;
+  std::vector<uint8_t> expectedTelegram;
+  std::vector<Aes128::Implementation> implementations{Aes128::Implementation::none};
+  auto &verifiedImplementations = Aes128::getVerifiedImplementations();
+  implementations.insert(implementations.end(), verifiedImplementations.begin(), verifiedImplementations.end());
+  for (auto implementation : implementations) {
+    BackendResult result;
+    result.implementation = implementation;
+    SecurityContext context(aesKey, implementation);
+    if (!context.isValid() || context.getImplementation() != implementation) {
+      results.push_back(result);
+      continue;
+    }
+
+    //Every implementation has to produce the same telegrams as libgcrypt.
+    auto cmac = security.getCmac(context, message, message.size(), 0x12345678, rollingCodeSize, cmacSize);
+    auto telegram = data;
+    if (!security.encryptExplicitRlc(context, telegram, telegram.size(), 0x12345678, rollingCodeSize, cmacSize)) cmac.clear();
+    if (implementation == Aes128::Implementation::none) {
+      expectedCmac = cmac;
+      expectedTelegram = telegram;
+    }
+    if (cmac.empty() || cmac != expectedCmac || telegram != expectedTelegram) {
+      results.push_back(result);
+      continue;
+    }
+
+    //The checksum keeps the compiler from removing the loops.
+    volatile uint32_t checksum = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+      checksum = checksum + security.getCmac(context, message, message.size(), round, rollingCodeSize, cmacSize).size();
+    }
+    result.cmacNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+      telegram = data;
+      checksum = checksum + (security.encryptExplicitRlc(context, telegram, telegram.size(), round, rollingCodeSize, cmacSize) ? 1 : 0);
+    }
+    result.encryptNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    result.telegrams = checksum != 0 ? rounds : 0;
+    results.push_back(result);
+  }
+
+  return results;
+}
+
+bool SecurityBenchmark::checkCmacImplicitRlcSequential(Security &security, SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize) {
+  try {
+    if ((signed)encryptedData.size() < dataSize + cmacSize) return false;
+    for (uint32_t currentRollingCode = rollingCode; currentRollingCode < rollingCode + Security::rollingCodeWindow; currentRollingCode++) {
+      std::vector<uint8_t> cmacInPacket(encryptedData.begin() + dataSize, encryptedData.begin() + dataSize + cmacSize);
+      std::vector<uint8_t> calculatedCmac = security.getCmac(context, encryptedData, dataSize, currentRollingCode, rollingCodeSize, cmacSize);
+      if (cmacInPacket.empty() || calculatedCmac.empty()) return false;
+
+      if (cmacInPacket.size() == calculatedCmac.size() && std::equal(cmacInPacket.begin(), cmacInPacket.end(), calculatedCmac.begin())) {
+        rollingCode = currentRollingCode;
+        return true;
+      }
+    }
+
+    return false;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void SecurityBenchmark::benchmarkThread(SecurityContext *context, int32_t rollingCodeSize, int32_t cmacSize, uint32_t rounds, ThreadResult *threadResult) {
+  try {
+    Security security(Gd::bl);
+    std::mt19937 generator(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+    uint32_t rollingCode = 0x00123456u & (0xFFFFFFFFu >> ((4 - rollingCodeSize) * 8));
+    auto rollingCodeBytes = getRollingCodeBytes(rollingCode, rollingCodeSize);
+
+    //Secure 4BS telegrams as the peer receives them: RORG, 4 data bytes, (rolling code,) CMAC
+    std::vector<uint8_t> explicitTelegram{0x31};
+    std::vector<uint8_t> implicitTelegram{0x30};
+    std::vector<uint8_t> payload;
+    for (uint32_t i = 0; i < 4; i++) {
+      explicitTelegram.push_back((uint8_t)byteDistribution(generator));
+      implicitTelegram.push_back((uint8_t)byteDistribution(generator));
+      payload.push_back((uint8_t)byteDistribution(generator));
+    }
+    const int32_t dataSize = 5;
+    auto cmac = security.getCmac(*context, explicitTelegram, dataSize, rollingCode, rollingCodeSize, cmacSize);
+    explicitTelegram.insert(explicitTelegram.end(), rollingCodeBytes.begin(), rollingCodeBytes.end());
+    explicitTelegram.insert(explicitTelegram.end(), cmac.begin(), cmac.end());
+    cmac = security.getCmac(*context, implicitTelegram, dataSize, rollingCode, rollingCodeSize, cmacSize);
+    implicitTelegram.insert(implicitTelegram.end(), cmac.begin(), cmac.end());
+
+    uint64_t verified = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+      auto data = explicitTelegram;
+      uint32_t newRollingCode = 0;
+      if (security.checkCmacExplicitRlc(*context, data, rollingCode - 1, newRollingCode, dataSize, rollingCodeSize, cmacSize) && security.decrypt(*context, data, dataSize, newRollingCode, rollingCodeSize)) verified++;
+    }
+    threadResult->verifyExplicitNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    uint64_t verifiedImplicit = 0;
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+      auto data = implicitTelegram;
+      uint32_t currentRollingCode = rollingCode;
+      if (security.checkCmacImplicitRlc(*context, data, dataSize, currentRollingCode, rollingCodeSize, cmacSize) && security.decrypt(*context, data, dataSize, currentRollingCode, rollingCodeSize)) verifiedImplicit++;
+    }
+    threadResult->verifyImplicitNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    uint64_t encrypted = 0;
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+      auto data = payload;
+      if (security.encryptExplicitRlc(*context, data, data.size(), rollingCode + round, rollingCodeSize, cmacSize)) encrypted++;
+    }
+    threadResult->encryptNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    threadResult->telegrams = verified == rounds && verifiedImplicit == rounds && encrypted == rounds ? rounds : 0;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+}
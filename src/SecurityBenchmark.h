@@ -0,0 +1,100 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef SECURITYBENCHMARK_H_
+#define SECURITYBENCHMARK_H_
+
+#include "Aes128.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EnOcean {
+
+class Security;
+class SecurityContext;
+
+/**
+ * Known-answer tests and micro-benchmarks of the secure telegram code in Security, run from the family CLI.
+ *
+ * EnOcean's CMAC is AES-CMAC (RFC 4493) truncated to 3 or 4 bytes, calculated over the telegram and the rolling code.
+ * For telegrams fitting into one block it equals the CMAC of RFC 4493, so the tests use its vectors and libgcrypt's
+ * CMAC and ECB implementations as references. All tests run with libgcrypt and with every verified built-in AES
+ * implementation (see Aes128).
+ */
+class SecurityBenchmark {
+ public:
+  struct TestResult {
+    uint32_t passed = 0;
+    std::vector<std::string> failures;
+  };
+
+  struct Result {
+    int32_t rollingCodeSize = 0;
+    int32_t cmacSize = 0;
+    uint32_t threads = 0;
+    uint64_t telegrams = 0;
+    /**
+     * Sum of the time each thread needed. Divided by "telegrams" this is the average time per telegram a thread sees,
+     * so contention shows as an increase.
+     */
+    uint64_t verifyExplicitNanoseconds = 0;
+    uint64_t verifyImplicitNanoseconds = 0;
+    uint64_t encryptNanoseconds = 0;
+  };
+
+  struct WindowSearchResult {
+    uint64_t telegrams = 0;
+    uint64_t sequentialNanoseconds = 0;
+    uint64_t batchedNanoseconds = 0;
+  };
+
+  struct BackendResult {
+    Aes128::Implementation implementation = Aes128::Implementation::none;
+    uint64_t telegrams = 0;
+    uint64_t cmacNanoseconds = 0;
+    uint64_t encryptNanoseconds = 0;
+  };
+
+  static TestResult runKnownAnswerTests();
+
+  /**
+   * Verifies and encrypts telegrams with all combinations of 2, 3 and 4 byte rolling codes and 3 and 4 byte CMACs.
+   *
+   * @param rounds Telegrams per thread and combination.
+   * @param threads Number of threads verifying and encrypting telegrams of the same device at the same time.
+   */
+  static std::vector<Result> run(uint32_t rounds, uint32_t threads);
+
+  /**
+   * Compares the sequential with the batched rolling code window search (Security::checkCmacImplicitRlc()) on telegrams
+   * matching none of the rolling codes, i. e. the worst case of a desynchronized device or a spoofed telegram.
+   */
+  static WindowSearchResult runWindowSearch(uint32_t rounds);
+
+  /**
+   * Measures the CMAC calculation and the encryption of secure telegrams with libgcrypt and with every verified
+   * built-in AES implementation. Implementations producing different telegrams than libgcrypt are returned with 0
+   * telegrams.
+   */
+  static std::vector<BackendResult> runBackends(uint32_t rounds);
+ private:
+  struct ThreadResult {
+    uint64_t telegrams = 0;
+    uint64_t verifyExplicitNanoseconds = 0;
+    uint64_t verifyImplicitNanoseconds = 0;
+    uint64_t encryptNanoseconds = 0;
+  };
+
+  static void runKnownAnswerTests(Aes128::Implementation implementation, TestResult &result);
+
+  /**
+   * The window search calling getCmac() for every rolling code. Reference for the batched search.
+   */
+  static bool checkCmacImplicitRlcSequential(Security &security, SecurityContext &context, const std::vector<uint8_t> &encryptedData, int32_t dataSize, uint32_t &rollingCode, int32_t rollingCodeSize, int32_t cmacSize);
+  static void benchmarkThread(SecurityContext *context, int32_t rollingCodeSize, int32_t cmacSize, uint32_t rounds, ThreadResult *threadResult);
+};
+
+}
+
+#endif
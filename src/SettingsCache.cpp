@@ -0,0 +1,39 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "SettingsCache.h"
+#include "Gd.h"
+#include "Aes128.h"
+
+namespace EnOcean {
+
+void SettingsCache::refresh() {
+  try {
+    if (!Gd::family) return;
+    auto roamingSetting = Gd::family->getFamilySetting("roaming");
+    bool roaming = !roamingSetting || roamingSetting->integerValue;
+    if (_roaming.exchange(roaming) != roaming) Gd::out.printInfo(std::string("Info: Roaming is now ") + (roaming ? "enabled." : "disabled."));
+
+    auto persistenceIntervalSetting = Gd::family->getFamilySetting("persistenceInterval");
+    uint32_t persistenceInterval = persistenceIntervalSetting && persistenceIntervalSetting->integerValue >= 0 ? (uint32_t)persistenceIntervalSetting->integerValue * 1000 : 60000;
+    if (_persistenceInterval.exchange(persistenceInterval) != persistenceInterval) Gd::out.printInfo("Info: Persistence interval is now " + std::to_string(persistenceInterval / 1000) + " s.");
+
+    auto rollingCodeReservationSetting = Gd::family->getFamilySetting("rollingCodeReservation");
+    //Larger reservations risk leaving the rolling code window of devices after an unclean restart.
+    uint32_t rollingCodeReservation = rollingCodeReservationSetting && rollingCodeReservationSetting->integerValue >= 0 ? (uint32_t)rollingCodeReservationSetting->integerValue : 32;
+    if (rollingCodeReservation > 100) rollingCodeReservation = 100;
+    if (_rollingCodeReservation.exchange(rollingCodeReservation) != rollingCodeReservation) Gd::out.printInfo("Info: Rolling code reservation is now " + std::to_string(rollingCodeReservation) + ".");
+
+    auto aesBackendSetting = Gd::family->getFamilySetting("aesBackend");
+    std::string aesBackendName = aesBackendSetting ? BaseLib::HelperFunctions::toLower(aesBackendSetting->stringValue) : "";
+    AesBackend aesBackend = AesBackend::automatic;
+    if (aesBackendName == "native") aesBackend = AesBackend::native;
+    else if (aesBackendName == "gcrypt") aesBackend = AesBackend::gcrypt;
+    else aesBackendName = "auto";
+    if (_aesBackend.exchange(aesBackend) != aesBackend) Gd::out.printInfo("Info: AES backend is now \"" + aesBackendName + "\" (" + Aes128::getName(aesBackend == AesBackend::gcrypt ? Aes128::Implementation::none : Aes128::select(aesBackend == AesBackend::native)) + ").");
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+}
@@ -0,0 +1,51 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef SETTINGSCACHE_H_
+#define SETTINGSCACHE_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace EnOcean {
+
+/**
+ * Typed snapshot of family settings which are needed on the receive path. Reading a field costs no map lookup and no
+ * lock. refresh() reads the settings again and logs changed values.
+ */
+class SettingsCache {
+ public:
+  enum class AesBackend : int32_t {
+    automatic = 0, //Built-in AES when the CPU has AES instructions, libgcrypt otherwise
+    native = 1, //Always built-in AES, the constant time software implementation on CPUs without AES instructions
+    gcrypt = 2
+  };
+
+  bool roaming() const { return _roaming.load(std::memory_order_relaxed); }
+
+  /**
+   * Maximum time in milliseconds database writes of values are deferred. 0 disables write-behind.
+   */
+  uint32_t persistenceInterval() const { return _persistenceInterval.load(std::memory_order_relaxed); }
+
+  /**
+   * Number of rolling codes reserved per database write. 0 stores every code.
+   */
+  uint32_t rollingCodeReservation() const { return _rollingCodeReservation.load(std::memory_order_relaxed); }
+
+  /**
+   * The AES implementation of security contexts. Contexts are created when AES keys are loaded or changed, so changes
+   * only apply to them.
+   */
+  AesBackend aesBackend() const { return _aesBackend.load(std::memory_order_relaxed); }
+
+  void refresh();
+ private:
+  std::atomic_bool _roaming{true};
+  std::atomic<uint32_t> _persistenceInterval{60000};
+  std::atomic<uint32_t> _rollingCodeReservation{32};
+  std::atomic<AesBackend> _aesBackend{AesBackend::automatic};
+};
+
+}
+
+#endif
@@ -0,0 +1,246 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#include "Sniffer.h"
+#include "Gd.h"
+
+namespace EnOcean {
+
+Sniffer::~Sniffer() {
+  stop();
+}
+
+void Sniffer::start(uint32_t bufferSize, const std::string &captureFile) {
+  try {
+    stop();
+
+    {
+      std::lock_guard<std::mutex> bufferGuard(_bufferMutex);
+      _buffer.clear();
+      _buffer.shrink_to_fit();
+      if (bufferSize == 0) bufferSize = 10000;
+      else if (bufferSize > maxBufferSize) bufferSize = maxBufferSize;
+      _buffer.resize(bufferSize);
+      _nextSequence = 1;
+      _summaries.clear();
+      _lru.clear();
+    }
+
+    if (!captureFile.empty()) {
+      std::lock_guard<std::mutex> captureGuard(_captureMutex);
+      _captureBuffer.clear();
+      _capturedInterfaces.clear();
+      _captureBytes = 0;
+      _captureDropped = 0;
+      _captureFile.open(captureFile, std::ios::out | std::ios::binary | std::ios::trunc);
+      if (_captureFile.is_open()) {
+        _captureFile.write("EOSNIFF1", 8);
+        _captureBytes = 8;
+        _stopCapture = false;
+        Gd::bl->threadManager.start(_captureThread, true, &Sniffer::captureWorker, this);
+        _capturing = true;
+      } else Gd::out.printError("Error: Could not open sniffer capture file " + captureFile + ".");
+    }
+
+    _running = true;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void Sniffer::stop() {
+  try {
+    _running = false;
+    _capturing = false;
+    _stopCapture = true;
+    _captureConditionVariable.notify_all();
+    Gd::bl->threadManager.join(_captureThread);
+    std::lock_guard<std::mutex> captureGuard(_captureMutex);
+    if (_captureFile.is_open()) _captureFile.close();
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+Sniffer::Telegram *Sniffer::getTelegram(uint64_t sequence) {
+  if (sequence == 0 || _buffer.empty()) return nullptr;
+  auto &telegram = _buffer[sequence % _buffer.size()];
+  return telegram.sequence == sequence ? &telegram : nullptr;
+}
+
+void Sniffer::addPacket(const PEnOceanPacket &packet) {
+  try {
+    if (!_running) return;
+    auto binary = packet->getBinaryView();
+
+    {
+      std::lock_guard<std::mutex> bufferGuard(_bufferMutex);
+      if (_buffer.empty()) return;
+      uint64_t sequence = _nextSequence++;
+      auto telegram = &_buffer[sequence % _buffer.size()];
+      telegram->sequence = sequence;
+      telegram->time = packet->getTimeReceived();
+      telegram->senderAddress = packet->senderAddress();
+      telegram->interfaceHandle = packet->getInterfaceHandle();
+      telegram->rssi = packet->getRssi();
+      //Reuses the slot's memory.
+      telegram->packet.assign(binary.begin(), binary.end());
+
+      auto summaryIterator = _summaries.find(telegram->senderAddress);
+      if (summaryIterator == _summaries.end()) {
+        if (_summaries.size() >= _maxSenders) {
+          _summaries.erase(_lru.back());
+          _lru.pop_back();
+        }
+        _lru.push_front(telegram->senderAddress);
+        summaryIterator = _summaries.emplace(telegram->senderAddress, Summary()).first;
+        summaryIterator->second.lruPosition = _lru.begin();
+        summaryIterator->second.firstSeen = telegram->time;
+      } else _lru.splice(_lru.begin(), _lru, summaryIterator->second.lruPosition);
+
+      auto &summary = summaryIterator->second;
+      summary.rorg = packet->getRorg();
+      summary.rssi = telegram->rssi;
+      summary.lastSeen = telegram->time;
+      summary.recentSequences[summary.count % recentTelegramCount] = sequence;
+      summary.count++;
+
+      if (_capturing) capture(*telegram);
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+std::vector<Sniffer::SenderSummary> Sniffer::getSenderSummaries() {
+  std::vector<SenderSummary> summaries;
+  try {
+    std::lock_guard<std::mutex> bufferGuard(_bufferMutex);
+    summaries.reserve(_summaries.size());
+    for (auto &summaryIterator : _summaries) {
+      auto &summary = summaryIterator.second;
+      SenderSummary senderSummary;
+      senderSummary.address = summaryIterator.first;
+      senderSummary.rorg = summary.rorg;
+      senderSummary.rssi = summary.rssi;
+      senderSummary.count = summary.count;
+      senderSummary.firstSeen = summary.firstSeen;
+      senderSummary.lastSeen = summary.lastSeen;
+      uint64_t recentCount = summary.count < recentTelegramCount ? summary.count : recentTelegramCount;
+      senderSummary.recentTelegrams.reserve(recentCount);
+      for (uint64_t i = summary.count - recentCount; i < summary.count; i++) {
+        auto telegram = getTelegram(summary.recentSequences[i % recentTelegramCount]);
+        if (telegram) senderSummary.recentTelegrams.push_back(*telegram);
+      }
+      summaries.push_back(std::move(senderSummary));
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return summaries;
+}
+
+std::vector<Sniffer::Telegram> Sniffer::getTelegrams(uint64_t from, uint32_t count, int32_t senderAddress, uint64_t &nextSequence) {
+  std::vector<Telegram> telegrams;
+  try {
+    std::lock_guard<std::mutex> bufferGuard(_bufferMutex);
+    uint64_t oldestSequence = _nextSequence > _buffer.size() ? _nextSequence - _buffer.size() : 1;
+    uint64_t sequence = from < oldestSequence ? oldestSequence : from;
+    for (; sequence < _nextSequence && telegrams.size() < count; sequence++) {
+      auto telegram = getTelegram(sequence);
+      if (!telegram || (senderAddress != -1 && telegram->senderAddress != senderAddress)) continue;
+      telegrams.push_back(*telegram);
+    }
+    nextSequence = sequence;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return telegrams;
+}
+
+Sniffer::Statistics Sniffer::getStatistics() {
+  Statistics statistics;
+  try {
+    {
+      std::lock_guard<std::mutex> bufferGuard(_bufferMutex);
+      statistics.telegrams = _nextSequence - 1;
+      statistics.bufferSize = _buffer.size();
+      statistics.senders = _summaries.size();
+    }
+    std::lock_guard<std::mutex> captureGuard(_captureMutex);
+    statistics.captureBytes = _captureBytes;
+    statistics.captureDropped = _captureDropped;
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return statistics;
+}
+
+void Sniffer::capture(const Telegram &telegram) {
+  std::string interfaceId;
+  std::lock_guard<std::mutex> captureGuard(_captureMutex);
+  bool newInterface = _capturedInterfaces.find(telegram.interfaceHandle) == _capturedInterfaces.end();
+  if (newInterface) {
+    interfaceId = Gd::interfaces->getInterfaceByHandle(telegram.interfaceHandle)->getID();
+    if (interfaceId.size() > 255) interfaceId.resize(255);
+  }
+
+  size_t recordSize = 14 + telegram.packet.size() + (newInterface ? 4 + interfaceId.size() : 0);
+  if (_captureBuffer.size() + recordSize > _maxCaptureBufferSize || telegram.packet.size() > 0xFFFF) {
+    _captureDropped++;
+    return;
+  }
+
+  if (newInterface) {
+    _capturedInterfaces.emplace(telegram.interfaceHandle);
+    _captureBuffer.push_back(0x01);
+    _captureBuffer.push_back(telegram.interfaceHandle & 0xFFu);
+    _captureBuffer.push_back((telegram.interfaceHandle >> 8u) & 0xFFu);
+    _captureBuffer.push_back(interfaceId.size());
+    _captureBuffer.insert(_captureBuffer.end(), interfaceId.begin(), interfaceId.end());
+  }
+
+  _captureBuffer.push_back(0x02);
+  for (uint32_t i = 0; i < 8; i++) {
+    _captureBuffer.push_back(((uint64_t)telegram.time >> (i * 8u)) & 0xFFu);
+  }
+  _captureBuffer.push_back(telegram.interfaceHandle & 0xFFu);
+  _captureBuffer.push_back((telegram.interfaceHandle >> 8u) & 0xFFu);
+  _captureBuffer.push_back((uint8_t)(int8_t)telegram.rssi);
+  _captureBuffer.push_back(telegram.packet.size() & 0xFFu);
+  _captureBuffer.push_back((telegram.packet.size() >> 8u) & 0xFFu);
+  _captureBuffer.insert(_captureBuffer.end(), telegram.packet.begin(), telegram.packet.end());
+  _captureBytes += recordSize;
+}
+
+void Sniffer::captureWorker() {
+  try {
+    std::vector<uint8_t> data;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> captureGuard(_captureMutex);
+        _captureConditionVariable.wait_for(captureGuard, std::chrono::milliseconds(1000), [&] { return (bool)_stopCapture; });
+        data.swap(_captureBuffer);
+      }
+
+      if (!data.empty()) {
+        //Only this thread writes to the file while it is running.
+        _captureFile.write((const char *)data.data(), data.size());
+        _captureFile.flush();
+        data.clear();
+      }
+
+      if (_stopCapture) break;
+    }
+  }
+  catch (const std::exception &ex) {
+    Gd::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+}
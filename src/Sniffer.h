@@ -0,0 +1,145 @@
+/* Copyright 2013-2019 Homegear GmbH */
+
+#ifndef SNIFFER_H_
+#define SNIFFER_H_
+
+#include "EnOceanPacket.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace EnOcean {
+
+/**
+ * Records telegrams of unknown senders while sniffing is enabled.
+ *
+ * Memory is fixed: Telegrams are stored in a ring buffer which overwrites the oldest telegram when full, and the
+ * per-sender summaries are bounded, too (the sender not seen for the longest time is evicted). Every telegram gets a
+ * sequence number, so RPC clients can page through the buffer.
+ *
+ * Optionally all telegrams are streamed to a binary capture file. The file starts with the 8 byte magic "EOSNIFF1",
+ * followed by records. All integers are little endian.
+ *  - 0x01 Interface: handle (2 bytes), ID length (1 byte), ID. Written before the first telegram of an interface.
+ *  - 0x02 Telegram: time in milliseconds (8 bytes), interface handle (2 bytes), RSSI (1 byte, signed), ESP3 frame
+ *    length (2 bytes), ESP3 frame.
+ * The file is written by a separate thread, so the receive path never waits for disk I/O.
+ */
+class Sniffer {
+ public:
+  static constexpr uint32_t recentTelegramCount = 8;
+
+  struct Telegram {
+    uint64_t sequence = 0;
+    int64_t time = 0;
+    int32_t senderAddress = 0;
+    uint32_t interfaceHandle = 0;
+    int32_t rssi = 0;
+    std::vector<uint8_t> packet;
+  };
+
+  struct SenderSummary {
+    int32_t address = 0;
+    uint8_t rorg = 0;
+    int32_t rssi = 0;
+    uint64_t count = 0;
+    int64_t firstSeen = 0;
+    int64_t lastSeen = 0;
+    /**
+     * The most recent telegrams of the sender which are still in the ring buffer. Oldest first.
+     */
+    std::vector<Telegram> recentTelegrams;
+  };
+
+  struct Statistics {
+    uint64_t telegrams = 0;
+    uint32_t bufferSize = 0;
+    uint32_t senders = 0;
+    uint64_t captureBytes = 0;
+    uint64_t captureDropped = 0;
+  };
+
+  /**
+   * Upper limit of the buffer size. The buffer is allocated completely when sniffing is started.
+   */
+  static constexpr uint32_t maxBufferSize = 1000000;
+
+  Sniffer() = default;
+  ~Sniffer();
+
+  /**
+   * Clears all recorded data and starts sniffing.
+   *
+   * @param bufferSize Number of telegrams kept in memory. Limited to maxBufferSize.
+   * @param captureFile Path of the capture file. The file is overwritten. Empty to not write a capture file.
+   */
+  void start(uint32_t bufferSize, const std::string &captureFile);
+  void stop();
+  bool isRunning() const { return _running; }
+
+  void addPacket(const PEnOceanPacket &packet);
+
+  std::vector<SenderSummary> getSenderSummaries();
+
+  /**
+   * Returns up to "count" telegrams with a sequence number of at least "from". Telegrams which were already
+   * overwritten are skipped.
+   *
+   * @param senderAddress Only return telegrams of this sender. -1 returns all telegrams.
+   * @param[out] nextSequence The sequence number to pass as "from" to get the next page.
+   */
+  std::vector<Telegram> getTelegrams(uint64_t from, uint32_t count, int32_t senderAddress, uint64_t &nextSequence);
+
+  Statistics getStatistics();
+ private:
+  static constexpr uint32_t _maxSenders = 10000;
+  static constexpr size_t _maxCaptureBufferSize = 1048576;
+
+  struct Summary {
+    uint8_t rorg = 0;
+    int32_t rssi = 0;
+    uint64_t count = 0;
+    int64_t firstSeen = 0;
+    int64_t lastSeen = 0;
+    //Sequence numbers of the last telegrams, used as a ring.
+    std::array<uint64_t, recentTelegramCount> recentSequences{};
+    std::list<int32_t>::iterator lruPosition;
+  };
+
+  std::atomic_bool _running{false};
+
+  std::mutex _bufferMutex;
+  std::vector<Telegram> _buffer;
+  //Sequence numbers start at 1, 0 marks an empty slot.
+  uint64_t _nextSequence = 1;
+  std::unordered_map<int32_t, Summary> _summaries;
+  //Most recently seen first
+  std::list<int32_t> _lru;
+
+  std::mutex _captureMutex;
+  std::condition_variable _captureConditionVariable;
+  std::thread _captureThread;
+  std::atomic_bool _capturing{false};
+  std::atomic_bool _stopCapture{false};
+  std::ofstream _captureFile;
+  std::vector<uint8_t> _captureBuffer;
+  std::unordered_set<uint32_t> _capturedInterfaces;
+  uint64_t _captureBytes = 0;
+  uint64_t _captureDropped = 0;
+
+  void capture(const Telegram &telegram);
+  void captureWorker();
+  Telegram *getTelegram(uint64_t sequence);
+};
+
+}
+
+#endif